@@ -0,0 +1,119 @@
+#ifndef FLAT_COMBINER_H
+#define FLAT_COMBINER_H
+
+// based on Hendler, Incze, Shavit and Tzafrir's
+// "Flat combining and the synchronization-parallelism tradeoff"
+
+#include "thread_registry.h"
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+namespace lock_free {
+
+// flat combining: поток публикует запрос в своей ячейке и ждет.
+// Поток, захвативший блокировку (combiner), выполняет все опубликованные
+// запросы над последовательной структурой подряд, пока она в его кэше,
+// остальные потоки только читают свою ячейку.
+// Op - запрос, N - число ячеек публикации
+template <typename Op, size_t N = 64>
+class flat_combiner
+{
+public:
+    flat_combiner(): locked(false)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            slots[i].state.store(free_slot);
+            slots[i].op = nullptr;
+        }
+    }
+
+    flat_combiner(const flat_combiner&) = delete;
+    flat_combiner& operator=(const flat_combiner&) = delete;
+
+    // выполнение запроса op, apply(Op&) вызывается под блокировкой
+    // для каждого опубликованного запроса (не обязательно этого потока)
+    template <typename F>
+    void execute(Op& op, F&& apply)
+    {
+        slot& s = acquire_slot();
+        s.op = &op;
+        s.state.store(pending, std::memory_order_release);
+
+        while (s.state.load(std::memory_order_acquire) != done)
+        {
+            if (try_lock())
+            {
+                combine(apply);
+                unlock();
+            } else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        s.state.store(free_slot, std::memory_order_release);
+    }
+
+protected:
+    // состояния ячейки
+    enum { free_slot = 0, claimed = 1, pending = 2, done = 3 };
+
+    struct alignas(128) slot
+    {
+        std::atomic<int> state;
+        Op* op;
+    };
+
+    alignas(128) std::atomic<bool> locked;
+    slot slots[N];
+
+    // ячейка выбирается по номеру потока (registered_thread_index),
+    // если ее заняли (потоков больше N), берется следующая свободная
+    slot& acquire_slot()
+    {
+        size_t i = registered_thread_index() % N;
+        while (true)
+        {
+            for (size_t j = 0; j < N; ++j)
+            {
+                slot& s = slots[(i + j) % N];
+                int expected = free_slot;
+                if (s.state.load(std::memory_order_relaxed) == free_slot &&
+                        s.state.compare_exchange_strong(expected, claimed))
+                    return s;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    bool try_lock()
+    {
+        return !locked.load(std::memory_order_relaxed) &&
+               !locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock()
+    {
+        locked.store(false, std::memory_order_release);
+    }
+
+    template <typename F>
+    void combine(F& apply)
+    {
+        for (size_t i = 0; i < N; ++i)
+        {
+            slot& s = slots[i];
+            if (s.state.load(std::memory_order_acquire) != pending)
+                continue;
+            apply(*s.op);
+            s.state.store(done, std::memory_order_release);
+        }
+    }
+};
+
+} // namespace lock_free
+
+#endif // FLAT_COMBINER_H
@@ -0,0 +1,97 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+// политики ожидания после неудачной CAS операции (contention management).
+// Объект политики создается на одну операцию контейнера,
+// вызов backoff() - после каждой неудачной попытки
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || \
+    defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define LOCK_FREE_CPU_PAUSE() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define LOCK_FREE_CPU_PAUSE() __asm__ __volatile__("yield")
+#else
+#define LOCK_FREE_CPU_PAUSE() std::this_thread::yield()
+#endif
+
+namespace lock_free {
+
+// пауза внутри цикла ожидания: процессор не спекулирует
+// по циклу и отдает ресурсы соседнему hyper-thread
+inline void cpu_pause(unsigned n)
+{
+    for (unsigned i = 0; i < n; ++i)
+        LOCK_FREE_CPU_PAUSE();
+}
+
+// псевдослучайное число потока (xorshift) для разброса ожиданий
+inline size_t backoff_random()
+{
+    thread_local static size_t seed =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+// без ожидания: повтор сразу, как было раньше
+struct no_backoff
+{
+    void operator()() { }
+};
+
+// экспоненциальное ожидание со случайным разбросом:
+// предел удваивается после каждой неудачи (от Min до Max пауз),
+// ждем случайное число пауз от половины предела до предела,
+// чтобы потоки, столкнувшиеся одновременно, не повторили CAS вместе
+template <unsigned Min = 4, unsigned Max = 1024>
+class exponential_backoff
+{
+    static_assert(Min > 0 && Min <= Max, "backoff limits must be 0 < Min <= Max");
+
+public:
+    exponential_backoff(): limit(Min) { }
+
+    void operator()()
+    {
+        unsigned half = limit / 2;
+        cpu_pause(half + static_cast<unsigned>(
+                      backoff_random() % (limit - half + 1)));
+        if (limit < Max)
+            limit = (limit * 2 < Max) ? limit * 2 : Max;
+    }
+
+protected:
+    unsigned limit;
+};
+
+// ожидание, пропорциональное числу неудач подряд:
+// Step пауз за каждую неудачу, не больше Max пауз
+template <unsigned Step = 16, unsigned Max = 1024>
+class proportional_backoff
+{
+    static_assert(Step > 0 && Step <= Max, "backoff limits must be 0 < Step <= Max");
+
+public:
+    proportional_backoff(): failures(0) { }
+
+    void operator()()
+    {
+        if (failures * Step < Max)
+            ++failures;
+        cpu_pause(failures * Step < Max ? failures * Step : Max);
+    }
+
+protected:
+    unsigned failures;
+};
+
+} // namespace lock_free
+
+#endif // BACKOFF_H
@@ -0,0 +1,157 @@
+#ifndef STRIPED_COUNTER_H
+#define STRIPED_COUNTER_H
+
+#include "thread_registry.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace lock_free {
+
+// счетчик из ячеек по одной на поток в отдельных кэш-линиях: у ячейки
+// один писатель, поэтому изменение - обычные чтение и запись без
+// атомарных read-modify-write операций и без борьбы за кэш-линию.
+// Потоки сверх N пишут в общую ячейку через fetch_add.
+// В ячейке две неубывающие суммы - прибавленного и вычтенного,
+// они же служат версиями для точного чтения exact_sum
+template <size_t N = max_registered_threads>
+class striped_counter
+{
+    static_assert(N > 0, "striped_counter needs at least one slot");
+
+public:
+    striped_counter()
+    {
+        for (size_t i = 0; i <= N; ++i)
+        {
+            slots[i].added.store(0, std::memory_order_relaxed);
+            slots[i].removed.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    striped_counter(const striped_counter&) = delete;
+    striped_counter& operator=(const striped_counter&) = delete;
+
+    // возвращает значение ячейки потока: по нему поток может
+    // выбирать, когда читать дорогую сумму (например, раз в 64 изменения)
+    int64_t add(int64_t n)
+    {
+        size_t i = registered_thread_index();
+        if (i >= N)
+            return add_shared(n);
+
+        slot& s = slots[i];
+        uint64_t added = s.added.load(std::memory_order_relaxed);
+        uint64_t removed = s.removed.load(std::memory_order_relaxed);
+        if (n >= 0)
+            s.added.store(added += n, std::memory_order_release);
+        else
+            s.removed.store(removed += -n, std::memory_order_release);
+        return static_cast<int64_t>(added - removed);
+    }
+
+    void increment()
+    {
+        add(1);
+    }
+
+    void decrement()
+    {
+        add(-1);
+    }
+
+    // сумма по ячейкам: без одновременных изменений точная, иначе
+    // приблизительная (ячейки читаются не одновременно, сумма может
+    // временно оказаться даже отрицательной)
+    int64_t sum() const
+    {
+        uint64_t s = 0;
+        for (size_t i = 0; i <= N; ++i)
+            s += slots[i].added.load(std::memory_order_relaxed) -
+                    slots[i].removed.load(std::memory_order_relaxed);
+        return static_cast<int64_t>(s);
+    }
+
+    // значение счетчика в один момент времени (double collect): ячейки
+    // читаются дважды, и если ни одна сумма не изменилась, все они
+    // одновременно имели прочитанные значения в момент между чтениями.
+    // Суммы в ячейках не убывают, поэтому совпадение значений означает
+    // отсутствие записей. Пока счетчик изменяется, чтение повторяется
+    int64_t exact_sum() const
+    {
+        uint64_t first[2 * (N + 1)];
+        collect(first);
+        for (;;)
+        {
+            uint64_t second[2 * (N + 1)];
+            collect(second);
+
+            bool same = true;
+            for (size_t i = 0; i < 2 * (N + 1); ++i)
+            {
+                if (first[i] != second[i])
+                {
+                    same = false;
+                    first[i] = second[i];
+                }
+            }
+
+            if (same)
+            {
+                uint64_t s = 0;
+                for (size_t i = 0; i < N + 1; ++i)
+                    s += first[2 * i] - first[2 * i + 1];
+                return static_cast<int64_t>(s);
+            }
+        }
+    }
+
+    // число элементов контейнера: сумма, не меньше 0
+    size_t size() const
+    {
+        int64_t s = sum();
+        return s > 0 ? static_cast<size_t>(s) : 0;
+    }
+
+    size_t exact_size() const
+    {
+        int64_t s = exact_sum();
+        return s > 0 ? static_cast<size_t>(s) : 0;
+    }
+
+protected:
+    struct alignas(128) slot
+    {
+        std::atomic<uint64_t> added;
+        std::atomic<uint64_t> removed;
+    };
+
+    int64_t add_shared(int64_t n)
+    {
+        slot& s = slots[N];
+        if (n >= 0)
+            s.added.fetch_add(n, std::memory_order_release);
+        else
+            s.removed.fetch_add(-n, std::memory_order_release);
+        return static_cast<int64_t>(s.added.load(std::memory_order_relaxed) -
+                s.removed.load(std::memory_order_relaxed));
+    }
+
+    void collect(uint64_t* values) const
+    {
+        for (size_t i = 0; i < N + 1; ++i)
+        {
+            values[2 * i] = slots[i].added.load(std::memory_order_acquire);
+            values[2 * i + 1] =
+                    slots[i].removed.load(std::memory_order_acquire);
+        }
+    }
+
+    // slots[N] - общая ячейка для потоков без своей
+    slot slots[N + 1];
+};
+
+} // namespace lock_free
+
+#endif // STRIPED_COUNTER_H
@@ -0,0 +1,57 @@
+#ifndef THREAD_REGISTRY_H
+#define THREAD_REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace lock_free {
+
+// число потоков, одновременно получающих свой номер
+const size_t max_registered_threads = 64;
+
+std::atomic<bool> registered_thread_busy[max_registered_threads];
+
+// номер потока для ячеек "по одной на поток" в объектах: поток
+// занимает свободный номер при первом обращении и освобождает его
+// при завершении, поэтому у живых потоков номера различны и остаются
+// небольшими. Если все номера заняты, поток получает
+// max_registered_threads - объект обслуживает его отдельно
+class registered_thread_owner
+{
+public:
+    registered_thread_owner(): index(max_registered_threads)
+    {
+        for (size_t i = 0; i < max_registered_threads; ++i)
+        {
+            bool expected = false;
+            if (!registered_thread_busy[i].load(std::memory_order_relaxed) &&
+                    registered_thread_busy[i].compare_exchange_strong(
+                            expected, true, std::memory_order_acquire))
+            {
+                index = i;
+                return;
+            }
+        }
+    }
+
+    ~registered_thread_owner()
+    {
+        // release: следующий владелец номера увидит последние
+        // записи этого потока в его ячейках
+        if (index < max_registered_threads)
+            registered_thread_busy[index].store(false,
+                                                std::memory_order_release);
+    }
+
+    size_t index;
+};
+
+inline size_t registered_thread_index()
+{
+    thread_local static registered_thread_owner owner;
+    return owner.index;
+}
+
+} // namespace lock_free
+
+#endif // THREAD_REGISTRY_H
@@ -0,0 +1,182 @@
+#ifndef CHASE_LEV_DEQUE_H
+#define CHASE_LEV_DEQUE_H
+
+// based on Chase, Lev. Dynamic circular work-stealing deque (2005)
+// и Le et al. Correct and efficient work-stealing for weak
+// memory models (2013)
+
+#include "hazard_pointer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace lock_free {
+
+// дек для планировщика с перехватом работы (work stealing):
+// поток-владелец добавляет и извлекает элементы с нижнего конца
+// (push/pop), CAS нужна только за последний элемент; остальные
+// потоки забирают элементы с верхнего конца (steal) одной CAS.
+// Кольцевой буфер растет вдвое при заполнении, старый буфер
+// может еще читаться другими потоками и удаляется через политику R
+// (hazard_reclamation, epoch_reclamation).
+// T хранится в std::atomic<T>, обычно это указатель на задачу
+template <typename T, typename R = hazard_reclamation>
+class chase_lev_deque
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "chase_lev_deque elements must be trivially copyable");
+
+public:
+    using value_type = T;
+
+    // log_capacity - двоичный логарифм начального размера буфера
+    explicit chase_lev_deque(unsigned log_capacity = 6):
+        top(0), bottom(0)
+    {
+        items.store(new buffer(log_capacity));
+    }
+
+    chase_lev_deque(const chase_lev_deque&) = delete;
+    chase_lev_deque& operator=(const chase_lev_deque&) = delete;
+
+    ~chase_lev_deque()
+    {
+        // старые буферы уже переданы R::retire
+        delete items.load();
+    }
+
+    // только поток-владелец
+    void push(T value)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        buffer* a = items.load(std::memory_order_relaxed);
+
+        if (b - t > static_cast<int64_t>(a->mask))
+            a = grow(a, t, b);
+
+        a->put(b, value);
+        // элемент виден до нового bottom
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // только поток-владелец, false - дек пуст
+    bool pop(T& result)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        buffer* a = items.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        // уменьшение bottom упорядочено с чтением top: steal,
+        // прочитавший старый bottom, увидит и CAS на top
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // дек был пуст
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        result = a->get(b);
+        if (t == b)
+        {
+            // последний элемент: соревнуемся с steal за top
+            bool won = top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // любой поток. false - дек пуст или элемент забрал
+    // другой поток (тогда можно попробовать еще раз)
+    bool steal(T& result)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+
+        // буфер может быть заменен владельцем и отправлен в retire
+        typename R::guard g;
+        buffer* a = g.protect(0, items);
+        T value = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed))
+            return false;
+
+        result = value;
+        return true;
+    }
+
+    // приблизительное число элементов
+    size_t size() const
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+protected:
+    struct buffer: reclaimable
+    {
+        size_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit buffer(unsigned log_capacity):
+            mask((static_cast<size_t>(1) << log_capacity) - 1),
+            slots(new std::atomic<T>[mask + 1]) { }
+
+        T get(int64_t i) const
+        {
+            return slots[static_cast<size_t>(i) & mask].load(
+                        std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T value)
+        {
+            slots[static_cast<size_t>(i) & mask].store(
+                        value, std::memory_order_relaxed);
+        }
+    };
+
+    // элементы [t, b) копируются в буфер двойного размера по тем же
+    // индексам, поэтому steal, читающий старый буфер, получает те же
+    // значения
+    buffer* grow(buffer* a, int64_t t, int64_t b)
+    {
+        unsigned log_capacity = 0;
+        while ((static_cast<size_t>(1) << log_capacity) <= a->mask)
+            ++log_capacity;
+
+        buffer* bigger = new buffer(log_capacity + 1);
+        for (int64_t i = t; i < b; ++i)
+            bigger->put(i, a->get(i));
+
+        items.store(bigger, std::memory_order_release);
+        R::retire(a);
+        return bigger;
+    }
+
+    // top изменяют все потоки, bottom - только владелец:
+    // в разных кэш-линиях
+    alignas(128) std::atomic<int64_t> top;
+    alignas(128) std::atomic<int64_t> bottom;
+    std::atomic<buffer*> items;
+};
+
+} // namespace lock_free
+
+#endif // CHASE_LEV_DEQUE_H
@@ -0,0 +1,140 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include "backoff.h"
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace lock_free {
+
+// задача планировщика. Выполняется один раз и удаляется,
+// после чего уменьшается счетчик незавершенных задач группы.
+// Исключения из задач не перехватываются
+struct task
+{
+    std::atomic<size_t>* pending;
+
+    task(): pending(nullptr) { }
+    virtual ~task() { }
+    virtual void execute() = 0;
+};
+
+template <typename F>
+struct function_task: task
+{
+    F f;
+
+    template <typename G>
+    explicit function_task(G&& g): f(std::forward<G>(g)) { }
+
+    void execute() override
+    {
+        f();
+    }
+};
+
+inline void run_task(task* t)
+{
+    t->execute();
+    std::atomic<size_t>* pending = t->pending;
+    delete t;
+    if (pending != nullptr)
+        pending->fetch_sub(1, std::memory_order_release);
+}
+
+// ожидание свободного потока, не нашедшего задач:
+// сначала паузы, затем уступаем процессор
+inline void executor_idle(unsigned& failures)
+{
+    if (failures < 64)
+    {
+        cpu_pause(1u << (failures / 16));
+        ++failures;
+    }
+    else
+        std::this_thread::yield();
+}
+
+// группа задач (fork/join): run порождает задачу в планировщике E,
+// wait ждет завершения всех задач группы, выполняя тем временем
+// чужие задачи, поэтому ожидание внутри задачи не блокирует поток.
+// E определяет spawn(task*) и run_one()
+template <typename E>
+class task_group
+{
+public:
+    explicit task_group(E& e): executor(e), pending(0) { }
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    ~task_group()
+    {
+        wait();
+    }
+
+    template <typename F>
+    void run(F&& f)
+    {
+        task* t = new function_task<typename std::decay<F>::type>(
+                    std::forward<F>(f));
+        t->pending = &pending;
+        pending.fetch_add(1, std::memory_order_relaxed);
+        executor.spawn(t);
+    }
+
+    void wait()
+    {
+        unsigned failures = 0;
+        while (pending.load(std::memory_order_acquire) != 0)
+        {
+            if (executor.run_one())
+                failures = 0;
+            else
+                executor_idle(failures);
+        }
+    }
+
+protected:
+    E& executor;
+    std::atomic<size_t> pending;
+};
+
+// диапазон делится пополам, правая половина уходит в отдельную задачу,
+// пока в левой больше grain элементов
+template <typename E, typename F>
+void parallel_for_split(task_group<E>& g, size_t first, size_t last,
+                        size_t grain, const F& f)
+{
+    while (last - first > grain)
+    {
+        size_t middle = first + (last - first) / 2;
+        g.run([&g, middle, last, grain, f]()
+              { parallel_for_split(g, middle, last, grain, f); });
+        last = middle;
+    }
+
+    for (size_t i = first; i < last; ++i)
+        f(i);
+}
+
+// f(i) для каждого i из [first, last), не меньше grain элементов на задачу
+template <typename E, typename F>
+void parallel_for(E& executor, size_t first, size_t last, size_t grain, F f)
+{
+    if (grain == 0)
+        grain = 1;
+
+    task_group<E> g(executor);
+    if (first < last)
+        parallel_for_split(g, first, last, grain, f);
+    g.wait();
+}
+
+} // namespace lock_free
+
+#endif // TASK_H
@@ -0,0 +1,220 @@
+#ifndef WORK_STEALING_EXECUTOR_H
+#define WORK_STEALING_EXECUTOR_H
+
+#include "backoff.h"
+#include "chase_lev_deque.h"
+#include "hazard_lock_free_queue.h"
+#include "hazard_pointer.h"
+#include "task.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace lock_free {
+
+// планировщик с перехватом работы: у каждого рабочего потока свой
+// chase_lev_deque. Задачи, порожденные рабочим потоком, добавляются
+// в его дек и выполняются им же в обратном порядке (LIFO, данные еще
+// в кэше); поток без задач забирает самую старую задачу из дека
+// случайного соседа. Задачи внешних потоков идут через общую очередь.
+// R - политика освобождения памяти (hazard_reclamation, epoch_reclamation)
+template <typename R = hazard_reclamation>
+class work_stealing_executor
+{
+public:
+    explicit work_stealing_executor(
+            size_t threads = std::thread::hardware_concurrency()):
+        stop(false)
+    {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; ++i)
+            workers.emplace_back(new worker());
+        for (size_t i = 0; i < threads; ++i)
+            workers[i]->thread = std::thread([this, i]() { work(i); });
+    }
+
+    work_stealing_executor(const work_stealing_executor&) = delete;
+    work_stealing_executor& operator=(const work_stealing_executor&) = delete;
+
+    ~work_stealing_executor()
+    {
+        stop.store(true);
+        for (auto& w : workers)
+            w->thread.join();
+
+        // оставшиеся задачи выполняются в потоке деструктора
+        while (run_one())
+            ;
+    }
+
+    size_t concurrency() const
+    {
+        return workers.size();
+    }
+
+    void spawn(task* t)
+    {
+        worker* w = current_worker();
+        if (w != nullptr)
+            w->tasks.push(t);
+        else
+            injected.enqueue(t);
+    }
+
+    // выполнение одной задачи: своей, из общей очереди или чужой,
+    // false - задач не нашлось
+    bool run_one()
+    {
+        task* t;
+        worker* w = current_worker();
+        if (w != nullptr && w->tasks.pop(t))
+        {
+            run_task(t);
+            return true;
+        }
+
+        if (injected.dequeue(t))
+        {
+            run_task(t);
+            return true;
+        }
+
+        // обход соседей со случайного
+        size_t count = workers.size();
+        size_t start = backoff_random() % count;
+        for (size_t i = 0; i < count; ++i)
+        {
+            worker* victim = workers[(start + i) % count].get();
+            if (victim != w && victim->tasks.steal(t))
+            {
+                run_task(t);
+                return true;
+            }
+        }
+        return false;
+    }
+
+protected:
+    struct alignas(128) worker
+    {
+        chase_lev_deque<task*, R> tasks;
+        std::thread thread;
+    };
+
+    // рабочий поток текущего потока в этом планировщике
+    worker* current_worker() const
+    {
+        return local_executor() == this ? local_worker() : nullptr;
+    }
+
+    static const work_stealing_executor*& local_executor()
+    {
+        thread_local static const work_stealing_executor* e = nullptr;
+        return e;
+    }
+
+    static worker*& local_worker()
+    {
+        thread_local static worker* w = nullptr;
+        return w;
+    }
+
+    void work(size_t i)
+    {
+        local_executor() = this;
+        local_worker() = workers[i].get();
+
+        unsigned failures = 0;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            if (run_one())
+                failures = 0;
+            else
+                executor_idle(failures);
+        }
+
+        // задачи своего дека доделываются до выхода
+        while (run_one())
+            ;
+
+        local_executor() = nullptr;
+        local_worker() = nullptr;
+    }
+
+    std::vector<std::unique_ptr<worker>> workers;
+    hazard_lock_free_queue<task*, R> injected;
+    std::atomic<bool> stop;
+};
+
+// планировщик с общей очередью задач Q для сравнения:
+// все потоки добавляют и извлекают задачи из одной очереди
+template <typename Q = hazard_lock_free_queue<task*>>
+class central_queue_executor
+{
+public:
+    explicit central_queue_executor(
+            size_t threads = std::thread::hardware_concurrency()):
+        stop(false)
+    {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; ++i)
+            workers.emplace_back([this]() { work(); });
+    }
+
+    central_queue_executor(const central_queue_executor&) = delete;
+    central_queue_executor& operator=(const central_queue_executor&) = delete;
+
+    ~central_queue_executor()
+    {
+        stop.store(true);
+        for (auto& t : workers)
+            t.join();
+
+        while (run_one())
+            ;
+    }
+
+    size_t concurrency() const
+    {
+        return workers.size();
+    }
+
+    void spawn(task* t)
+    {
+        tasks.enqueue(t);
+    }
+
+    bool run_one()
+    {
+        task* t;
+        if (!tasks.dequeue(t))
+            return false;
+        run_task(t);
+        return true;
+    }
+
+protected:
+    void work()
+    {
+        unsigned failures = 0;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            if (run_one())
+                failures = 0;
+            else
+                executor_idle(failures);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    Q tasks;
+    std::atomic<bool> stop;
+};
+
+} // namespace lock_free
+
+#endif // WORK_STEALING_EXECUTOR_H
@@ -1,14 +1,18 @@
 #ifndef HASH_H
 #define HASH_H
 
+#include "hash_policy.h"
 #include "tbb/concurrent_hash_map.h"
 
+#include <cstdint>
+
 const size_t max_buckets = 256;
 
 struct key
 {
     int value;
 
+    key(): value(0) { }
     key(int key): value(key) { }
 
     bool operator == (const key& other) const
@@ -27,7 +31,56 @@ struct key
     }
 };
 
-// для locked hash table
+// 128-битный идентификатор
+struct id128
+{
+    uint64_t hi;
+    uint64_t lo;
+
+    id128(): hi(0), lo(0) { }
+    id128(uint64_t h, uint64_t l): hi(h), lo(l) { }
+
+    bool operator == (const id128& other) const
+    {
+        return hi == other.hi && lo == other.lo;
+    }
+
+    bool operator >= (const id128& other) const
+    {
+        return hi > other.hi || (hi == other.hi && lo >= other.lo);
+    }
+
+    bool operator != (const id128& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+namespace lock_free
+{
+    template <>
+    struct hasher<key>
+    {
+        static size_t hash(const key& k)
+        {
+            return static_cast<size_t>(
+                        mix64(static_cast<uint64_t>(k.value)));
+        }
+    };
+
+    template <>
+    struct hasher<id128>
+    {
+        static size_t hash(const id128& k)
+        {
+            return static_cast<size_t>(hash_mix(k.hi ^ hash_secret0,
+                                                k.lo ^ hash_secret1));
+        }
+    };
+}
+
+// для std::unordered_map и других контейнеров std: та же хеш-функция,
+// что и у таблиц, без привязки к числу корзин
 namespace std
 {
     template <>
@@ -35,21 +88,9 @@ namespace std
     {
         std::size_t operator()(const key& k) const
         {
-            return (k.value) % max_buckets;
+            return lock_free::hasher<key>::hash(k);
         }
     };
 }
 
-// для tbb и lock free hash table
-struct my_hash
-{
-    static size_t hash(const key& key) {
-        return (key.value) % max_buckets;
-    }
-
-    static bool equal(const key& x, const key& y) {
-        return x.value == y.value;
-    }
-};
-
 #endif // HASH_H
@@ -0,0 +1,286 @@
+#ifndef HASH_POLICY_H
+#define HASH_POLICY_H
+
+// перемешивающие функции по мотивам wyhash (Wang Yi, public domain)
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace lock_free {
+
+const uint64_t hash_secret0 = 0xa0761d6478bd642full;
+const uint64_t hash_secret1 = 0xe7037ed1a0b428dbull;
+const uint64_t hash_secret2 = 0x8ebc6af09c88c6e3ull;
+
+// 64x64 -> 128 умножение, возвращает младшую и старшую половины
+inline void hash_mum(uint64_t& a, uint64_t& b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    a = static_cast<uint64_t>(r);
+    b = static_cast<uint64_t>(r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32;
+    uint64_t la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    a = lo;
+    b = hi;
+#endif
+}
+
+inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+    hash_mum(a, b);
+    return a ^ b;
+}
+
+// хеш целого числа: все биты результата зависят от всех битов ключа,
+// поэтому номер корзины можно брать маской по младшим битам
+inline uint64_t mix64(uint64_t v)
+{
+    return hash_mix(v ^ hash_secret0, hash_secret1);
+}
+
+namespace detail {
+
+inline uint64_t read8(const uint8_t* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t read4(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+} // namespace detail
+
+// хеш произвольной последовательности байт
+inline uint64_t hash_bytes(const void* data, size_t len, uint64_t seed = 0)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    seed ^= hash_mix(seed ^ hash_secret0, hash_secret1);
+
+    uint64_t a, b;
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            size_t shift = (len >> 3) << 2;
+            a = (detail::read4(p) << 32) | detail::read4(p + shift);
+            b = (detail::read4(p + len - 4) << 32) |
+                 detail::read4(p + len - 4 - shift);
+        }
+        else if (len > 0)
+        {
+            a = (static_cast<uint64_t>(p[0]) << 16) |
+                (static_cast<uint64_t>(p[len >> 1]) << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        size_t i = len;
+        while (i > 16)
+        {
+            seed = hash_mix(detail::read8(p) ^ hash_secret1,
+                            detail::read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        a = detail::read8(p + i - 16);
+        b = detail::read8(p + i - 8);
+    }
+
+    a ^= hash_secret1;
+    b ^= seed;
+    hash_mum(a, b);
+    return hash_mix(a ^ hash_secret0 ^ len, b ^ hash_secret1);
+}
+
+// хешер по умолчанию: специализации для целых чисел и строк,
+// для своих типов ключей добавляются специализации hasher<K>
+// со статической функцией hash
+template <typename K, typename = void>
+struct hasher;
+
+template <typename K>
+struct hasher<K, typename std::enable_if<std::is_integral<K>::value>::type>
+{
+    static size_t hash(K key)
+    {
+        return static_cast<size_t>(mix64(static_cast<uint64_t>(key)));
+    }
+};
+
+template <>
+struct hasher<std::string>
+{
+    static size_t hash(const std::string& key)
+    {
+        return static_cast<size_t>(hash_bytes(key.data(), key.size()));
+    }
+};
+
+// интерфейс хеш-функции для таблиц (и tbb::concurrent_hash_map):
+// статические hash(key) и equal(key, key)
+template <typename K, typename Hasher = hasher<K>>
+struct hash_compare
+{
+    static size_t hash(const K& key)
+    {
+        return Hasher::hash(key);
+    }
+
+    static bool equal(const K& x, const K& y)
+    {
+        return x == y;
+    }
+};
+
+// проверка, что H подходит как хеш-функция для ключей K
+template <typename H, typename K, typename = void>
+struct is_hash_compare: std::false_type { };
+
+template <typename H, typename K>
+struct is_hash_compare<H, K, typename std::enable_if<
+        std::is_convertible<decltype(H::hash(std::declval<const K&>())),
+                            size_t>::value &&
+        std::is_convertible<decltype(H::equal(std::declval<const K&>(),
+                                              std::declval<const K&>())),
+                            bool>::value>::type>: std::true_type { };
+
+// адаптеры для std::unordered_map
+template <typename H>
+struct std_hasher
+{
+    template <typename K>
+    size_t operator()(const K& key) const
+    {
+        return H::hash(key);
+    }
+};
+
+template <typename H>
+struct std_key_equal
+{
+    template <typename K>
+    bool operator()(const K& x, const K& y) const
+    {
+        return H::equal(x, y);
+    }
+};
+
+// выбор корзины по хешу: число корзин округляется
+// до степени двойки, номер корзины - маска вместо деления
+class power_of_two_buckets
+{
+public:
+    power_of_two_buckets(size_t n)
+    {
+        size_t s = 1;
+        while (s < n)
+            s <<= 1;
+        mask = s - 1;
+    }
+
+    size_t count() const
+    {
+        return mask + 1;
+    }
+
+    size_t index(size_t h) const
+    {
+        return h & mask;
+    }
+
+protected:
+    size_t mask;
+};
+
+// выбор корзины остатком от деления, для произвольного числа корзин
+class modulo_buckets
+{
+public:
+    modulo_buckets(size_t n): buckets(n) { }
+
+    size_t count() const
+    {
+        return buckets;
+    }
+
+    size_t index(size_t h) const
+    {
+        return h % buckets;
+    }
+
+protected:
+    size_t buckets;
+};
+
+// заполнение хеш-таблицы, считается обходом всех корзин.
+// Без одновременных изменений значения точные, иначе обход
+// weakly consistent: каждое поле согласовано только с самим собой
+struct hash_table_stats
+{
+    size_t elements;
+    size_t buckets;
+    // непустые корзины
+    size_t used_buckets;
+    // самая длинная цепочка (у открытой адресации - серия занятых ячеек)
+    size_t longest_chain;
+
+    hash_table_stats():
+        elements(0), buckets(0), used_buckets(0), longest_chain(0) { }
+
+    double load_factor() const
+    {
+        return buckets == 0 ? 0.0 : static_cast<double>(elements) / buckets;
+    }
+
+    double average_chain() const
+    {
+        return used_buckets == 0 ? 0.0 :
+               static_cast<double>(elements) / used_buckets;
+    }
+
+    // учет корзины с length элементами
+    void add_chain(size_t length)
+    {
+        elements += length;
+        if (length != 0)
+            ++used_buckets;
+        if (length > longest_chain)
+            longest_chain = length;
+    }
+
+    void merge(const hash_table_stats& other)
+    {
+        elements += other.elements;
+        used_buckets += other.used_buckets;
+        if (other.longest_chain > longest_chain)
+            longest_chain = other.longest_chain;
+    }
+};
+
+} // namespace lock_free
+
+#endif // HASH_POLICY_H
@@ -1,57 +1,59 @@
 ﻿#ifndef LOCK_FREE_HASH_TABLE_H
 #define LOCK_FREE_HASH_TABLE_H
 
-#include "hazard_pointer.h"
 #include "hash.h"
+#include "lock_free_list.h"
+#include "striped_counter.h"
+#include "task.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace lock_free {
 
-template <typename K, typename T, typename H>
-class lock_free_hash_table
+template <typename K, typename T, typename H = hash_compare<K>,
+          typename B = power_of_two_buckets,
+          typename R = hazard_reclamation, typename C = no_backoff,
+          typename A = global_allocation>
+class lock_free_hash_table: protected lock_free_list<K, T, R, C, A>
 {
+    static_assert(is_hash_compare<H, K>::value,
+                  "H must provide static hash(key) and equal(key, key)");
+
 protected:
-    struct node;
-    using marked_ptr = node*;
+    using base = lock_free_list<K, T, R, C, A>;
+    using typename base::node;
+    using typename base::marked_ptr;
+    using base::list_insert;
+    using base::list_delete;
+    using base::list_search;
+    using base::list_visit;
+    using base::list_search_group;
+    using base::list_assign;
+    using base::batch_group;
+    using typename base::guard;
+    using typename base::list_cursor;
+    using base::list_next;
+    using base::list_for_each;
+
+    B bucket;
     size_t buckets;
-
-    struct node
-    {
-        K key;
-        T data;
-        std::atomic<marked_ptr> next;
-
-        node(K k): key(k) { }
-        node(K k, T val): key(k), data(val) { }
-    };
-
-    // marked ptr operations
-    static uintptr_t get_bit(marked_ptr p)
-    {
-        return reinterpret_cast<uintptr_t>(p) & 1;
-    }
-
-    static marked_ptr set_bit(marked_ptr p, uintptr_t bit)
-    {
-        return reinterpret_cast<marked_ptr>(
-                    (reinterpret_cast<uintptr_t>(p)) | bit);
-    }
-
-    static marked_ptr get_ptr(marked_ptr p)
-    {
-        return reinterpret_cast<marked_ptr>((reinterpret_cast<uintptr_t>(p))
-                                            & ~(static_cast<uintptr_t>(1)));
-    }
+    // число элементов, каждый поток изменяет свою полосу
+    striped_counter<> elements;
 
 public:
     // lock-free ordered lists
     std::atomic<marked_ptr>* table;
 
-    lock_free_hash_table(size_t mb = max_buckets)
+    lock_free_hash_table(size_t mb = max_buckets): bucket(mb)
     {
-        buckets = mb;
+        buckets = bucket.count();
         table = new std::atomic<marked_ptr>[buckets];
         for (size_t i = 0; i < buckets; ++i)
             table[i] = nullptr;
@@ -66,10 +68,34 @@ public:
     // hash table operaions
     bool hash_insert(K key, const T& value)
     {
-        node* new_node = new node(key);
-        new_node->data = value;
-        if (list_insert(&table[H::hash(key)], new_node))
+        return hash_emplace(key, value);
+    }
+
+    // при неудаче (ключ уже есть) value остается у вызывающего
+    bool hash_insert(K key, T&& value)
+    {
+        node* new_node = new node(key, std::move(value));
+        if (list_insert(&table[bucket.index(H::hash(key))], new_node))
+        {
+            elements.increment();
+            return true;
+        }
+
+        value = std::move(new_node->data);
+        delete new_node;
+        return false;
+    }
+
+    // элемент создается сразу в узле из args
+    template <typename... Args>
+    bool hash_emplace(K key, Args&&... args)
+    {
+        node* new_node = new node(key, std::forward<Args>(args)...);
+        if (list_insert(&table[bucket.index(H::hash(key))], new_node))
+        {
+            elements.increment();
             return true;
+        }
 
         delete new_node;
         return false;
@@ -77,224 +103,519 @@ public:
 
     bool hash_delete(K key)
     {
-        return list_delete(&table[H::hash(key)], key);
+        if (!list_delete(&table[bucket.index(H::hash(key))], key))
+            return false;
+        elements.decrement();
+        return true;
     }
 
     bool hash_search(K key, T& result)
     {
-        return list_search(&table[H::hash(key)], key, result);
+        return list_search(&table[bucket.index(H::hash(key))], key, result);
     }
 
-    // печать ключей в таблице
-    void print_hash_table()
+    // f(const T&) вызывается для найденного элемента без копирования
+    template <typename F>
+    bool hash_visit(K key, F&& f)
     {
-        for (size_t i = 0; i < buckets; ++i)
+        return list_visit(&table[bucket.index(H::hash(key))], key,
+                          std::forward<F>(f));
+    }
+
+    // вставка или замена значения за один проход по списку,
+    // ключ не пропадает из таблицы во время замены.
+    // true - ключ вставлен, false - значение заменено
+    bool insert_or_assign(K key, const T& value)
+    {
+        return counted(list_assign(&table[bucket.index(H::hash(key))], key,
+                                   [&](const T*, node* spare)
         {
-            marked_ptr curr = (*(table + i)).load();
-            std::cout << i << " : ";
-            while (curr != nullptr)
+            return spare ? spare : new node(key, value);
+        }));
+    }
+
+    bool insert_or_assign(K key, T&& value)
+    {
+        return counted(list_assign(&table[bucket.index(H::hash(key))], key,
+                                   [&](const T*, node* spare)
+        {
+            // value перемещается один раз, узел переиспользуется
+            return spare ? spare : new node(key, std::move(value));
+        }));
+    }
+
+    // f(T&) изменяет копию текущего значения, копия заменяет его
+    // одной CAS операцией. При гонке f вызывается снова для нового
+    // значения, поэтому не должна иметь побочных эффектов.
+    // false - ключа нет
+    template <typename F>
+    bool update(K key, F&& f)
+    {
+        return list_assign(&table[bucket.index(H::hash(key))], key,
+                           [&](const T* current, node* spare) -> node*
+        {
+            if (current == nullptr)
+                return nullptr;
+            if (spare)
+                spare->data = *current;
+            else
+                spare = new node(key, *current);
+            f(spare->data);
+            return spare;
+        }) == base::assign_replaced;
+    }
+
+    // замена значения на desired, если оно равно expected; иначе
+    // в expected записывается текущее значение.
+    // false - значение не равно expected или ключа нет
+    bool compare_exchange_value(K key, T& expected, const T& desired)
+    {
+        return list_assign(&table[bucket.index(H::hash(key))], key,
+                           [&](const T* current, node* spare) -> node*
+        {
+            if (current == nullptr)
+                return nullptr;
+            if (!(*current == expected))
             {
-                std::cout << curr->key.value << " ";
-                curr = curr->next.load();
+                expected = *current;
+                return nullptr;
             }
+            return spare ? spare : new node(key, desired);
+        }) == base::assign_replaced;
+    }
 
-            std::cout << std::endl;
+    // поиск count ключей: found[i] - найден ли keys[i], results[i] - его
+    // значение. Хеши и корзины считаются для группы ключей сразу,
+    // строки кэша корзин и узлов запрашиваются заранее, цепочки
+    // группы обходятся вперемешку (см. list_search_group).
+    // Возвращает число найденных ключей
+    size_t hash_search_batch(const K* keys, size_t count,
+                             T* results, bool* found)
+    {
+        size_t total = 0;
+        std::atomic<marked_ptr>* heads[batch_group];
+        for (size_t first = 0; first < count; first += batch_group)
+        {
+            size_t n = count - first < batch_group ? count - first : batch_group;
+            for (size_t i = 0; i < n; ++i)
+            {
+                heads[i] = &table[bucket.index(H::hash(keys[first + i]))];
+                LOCK_FREE_PREFETCH(heads[i]);
+            }
+            total += list_search_group(heads, keys + first, n,
+                                       results + first, found + first);
         }
+        return total;
     }
 
-    // получить сумму ключей в таблице
-    int get_sum()
+    // вставка count пар keys[i], values[i]; корзины и первые узлы
+    // группы запрашиваются заранее, сами вставки идут по очереди.
+    // inserted[i] (если не nullptr) - вставлен ли keys[i].
+    // Возвращает число вставленных ключей
+    size_t hash_insert_batch(const K* keys, const T* values, size_t count,
+                             bool* inserted = nullptr)
     {
-        int sum = 0;
-        for (size_t i = 0; i < buckets; ++i)
+        size_t total = 0;
+        std::atomic<marked_ptr>* heads[batch_group];
+        for (size_t first = 0; first < count; first += batch_group)
         {
-            marked_ptr curr = (*(table + i)).load();
+            size_t n = count - first < batch_group ? count - first : batch_group;
+            for (size_t i = 0; i < n; ++i)
+            {
+                heads[i] = &table[bucket.index(H::hash(keys[first + i]))];
+                LOCK_FREE_PREFETCH(heads[i]);
+            }
+            for (size_t i = 0; i < n; ++i)
+                LOCK_FREE_PREFETCH(base::get_ptr(heads[i]->load()));
 
-            while (curr != nullptr)
+            for (size_t i = 0; i < n; ++i)
             {
-                sum += curr->key.value;
-                curr = curr->next.load();
+                node* new_node = new node(keys[first + i], values[first + i]);
+                bool ok = list_insert(heads[i], new_node);
+                if (!ok)
+                    delete new_node;
+                if (inserted != nullptr)
+                    inserted[first + i] = ok;
+                total += ok;
             }
         }
+        elements.add(total);
+        return total;
+    }
 
-        return sum;
+    // число элементов по счетчику: операции не обращаются к общей
+    // переменной, при одновременных изменениях значение приблизительное.
+    // Точный подсчет обходом - stats()
+    size_t size() const
+    {
+        return elements.size();
     }
 
-protected:
-    std::atomic<marked_ptr>* prev;
-    marked_ptr curr, next;
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
 
-    marked_ptr list_find(std::atomic<marked_ptr>* head, K key,
-                   std::atomic<marked_ptr>** out_prev, marked_ptr* out_next)
+    bool empty() const
     {
-        std::atomic<marked_ptr>* prev;
-        marked_ptr curr, next;
+        return size() == 0;
+    }
 
-        try_again:
+    size_t bucket_count() const
+    {
+        return buckets;
+    }
 
-        prev = head;
-        curr = (*prev).load();
-        next = nullptr;
+    double load_factor() const
+    {
+        return static_cast<double>(size()) / buckets;
+    }
 
-        std::atomic<void*>& hp0 = get_hazard_pointer_for_current_thread(0);
-        std::atomic<void*>& hp1 = get_hazard_pointer_for_current_thread(1);
-        std::atomic<void*>& hp2 = get_hazard_pointer_for_current_thread(2);
+    // обход всех корзин под защитой SMR: число элементов, непустые
+    // корзины, самая длинная цепочка (см. hash_table_stats).
+    // threads - число потоков обхода, по умолчанию обход идет
+    // в текущем потоке без создания новых
+    hash_table_stats stats(size_t threads = 1)
+    {
+        return stats_on(thread_launcher{threads});
+    }
 
-        hp1.store(curr);
+    // то же, корзины обходят задачи планировщика executor
+    // (work_stealing_executor и т.п.) вместе с текущим потоком
+    template <typename E, typename = decltype(std::declval<E&>().run_one())>
+    hash_table_stats stats(E& executor)
+    {
+        return stats_on(executor_launcher<E>{executor});
+    }
 
-        while (true)
-        {
-            if (get_ptr(curr) == nullptr)
-                goto done;
+    class items_view;
+
+    // обход всей таблицы, безопасный при одновременных изменениях
+    items_view items()
+    {
+        return items_view(this);
+    }
+
+    // f(const K&, const T&) для каждого элемента, корзины делятся между
+    // threads потоками (текущий поток тоже работает), f вызывается
+    // из разных потоков одновременно. По умолчанию threads = 1 - обход
+    // в текущем потоке без создания новых. Обход weakly consistent, как
+    // у items(). Возвращает число элементов
+    template <typename F>
+    size_t parallel_for_each(F f, size_t threads = 1)
+    {
+        return parallel_for_each_on(thread_launcher{threads}, f);
+    }
 
-            next = get_ptr(curr)->next.load();
-            hp0.store(next);
+    // то же на задачах планировщика executor: потоки не создаются
+    // при каждом вызове, а берутся из его пула
+    template <typename E, typename F,
+              typename = decltype(std::declval<E&>().run_one())>
+    size_t parallel_for_each(E& executor, F f)
+    {
+        return parallel_for_each_on(executor_launcher<E>{executor}, f);
+    }
 
-            K ckey = get_ptr(curr)->key;
+    // свертка элементов: каждый поток накапливает свое значение
+    // acc = reduce(acc, map(key, value)) от init, результаты потоков
+    // объединяются через combine(acc, acc) в текущем потоке.
+    // По умолчанию threads = 1, как у parallel_for_each
+    template <typename V, typename M, typename F, typename G>
+    V parallel_reduce(V init, M map, F reduce, G combine, size_t threads = 1)
+    {
+        return parallel_reduce_on(thread_launcher{threads},
+                                  init, map, reduce, combine);
+    }
 
-            if ((*prev).load() != curr)
-                goto try_again;
+    template <typename E, typename V, typename M, typename F, typename G,
+              typename = decltype(std::declval<E&>().run_one())>
+    V parallel_reduce(E& executor, V init, M map, F reduce, G combine)
+    {
+        return parallel_reduce_on(executor_launcher<E>{executor},
+                                  init, map, reduce, combine);
+    }
+
+    // обход таблицы по корзинам, элементы одной корзины - по возрастанию
+    // ключей. Элемент, который был в таблице все время обхода, встретится
+    // ровно один раз, добавленные или удаленные во время обхода - может
+    // быть. Итератор однопроходный (input iterator), текущий элемент
+    // защищен hazard указателем 3 view, поэтому в потоке одновременно
+    // обходится не больше одного items_view; операции над контейнерами
+    // между шагами обхода допустимы
+    class items_view
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type        = T;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const T*;
+            using reference         = const T&;
+
+            const K& key() const
+            {
+                return view->cursor.curr->key;
+            }
 
-            if (!get_bit(next))
+            const T& value() const
             {
-                if (ckey >= key)
-                    goto done;
+                return view->cursor.curr->data;
+            }
 
-                prev=&(get_ptr(curr)->next);
-                hp2.store(curr);
-            } else
+            const T& operator*() const
             {
-                marked_ptr cur = get_ptr(curr);
-                if (prev->compare_exchange_strong(cur, get_ptr(next)))
-                {
-                    reclaim_later(curr);
-                }
-                else
-                {
-                    goto try_again;
-                }
+                return value();
             }
 
-            curr = next;
-            hp1.store(next);
-        }
+            const T* operator->() const
+            {
+                return &value();
+            }
 
-        done:
+            iterator& operator++()
+            {
+                view->advance();
+                return *this;
+            }
 
-        *out_prev = prev;
-        *out_next = next;
-        return curr;
-    }
+            bool operator==(const iterator& other) const
+            {
+                return at_end() == other.at_end();
+            }
 
-    bool list_insert(std::atomic<marked_ptr>* head, marked_ptr new_node)
-    {
-        std::atomic<void*>& hp0 = get_hazard_pointer_for_current_thread(0);
-        std::atomic<void*>& hp1 = get_hazard_pointer_for_current_thread(1);
-        std::atomic<void*>& hp2 = get_hazard_pointer_for_current_thread(2);
+            bool operator!=(const iterator& other) const
+            {
+                return !(*this == other);
+            }
 
-        K key = new_node->key;
-        bool result = false;
+        protected:
+            friend class items_view;
 
-        std::atomic<marked_ptr>* prev;
-        marked_ptr curr, next;
+            items_view* view;
 
-        while (true)
-        {
-            curr = list_find(head, key, &prev, &next);
+            explicit iterator(items_view* v): view(v) { }
 
-            if (get_ptr(curr) != nullptr)
+            bool at_end() const
             {
-                if (get_ptr(curr)->key == key)
-                {
-                    result = false;
-                    break;
-                }
+                return view == nullptr || view->cursor.curr == nullptr;
             }
+        };
+
+        items_view(const items_view&) = delete;
+        items_view& operator=(const items_view&) = delete;
+
+        iterator begin()
+        {
+            return iterator(this);
+        }
+
+        iterator end()
+        {
+            return iterator(nullptr);
+        }
 
-            new_node->next.store(get_ptr(curr));
-            marked_ptr cur = get_ptr(curr);
-            if (prev->compare_exchange_strong(cur, get_ptr(new_node)))
+    protected:
+        friend class lock_free_hash_table;
+
+        guard g;
+        lock_free_hash_table* table;
+        size_t index;
+        list_cursor cursor;
+
+        explicit items_view(lock_free_hash_table* t):
+            table(t), index(0), cursor(&t->table[0])
+        {
+            if (!table->list_next(g, cursor))
+                advance();
+        }
+
+        // следующий элемент этой или следующих корзин
+        void advance()
+        {
+            if (cursor.curr != nullptr && table->list_next(g, cursor))
+                return;
+
+            while (++index < table->buckets)
             {
-                result = true;
-                break;
+                cursor = list_cursor(&table->table[index]);
+                if (table->list_next(g, cursor))
+                    return;
             }
+            cursor.curr = nullptr;
         }
+    };
 
-        hp0.store(nullptr);
-        hp1.store(nullptr);
-        hp2.store(nullptr);
-
-        return result;
+protected:
+    bool counted(typename base::assign_result r)
+    {
+        if (r != base::assign_inserted)
+            return false;
+        elements.increment();
+        return true;
     }
 
-    bool list_delete(std::atomic<marked_ptr>* head, K key)
+    // запуск run(k) для k из [0, n): k = 0 выполняет текущий поток,
+    // остальные - новые потоки (при threads = 1 их нет)
+    struct thread_launcher
     {
-        bool result = false;
-        std::atomic<void*>& hp0 = get_hazard_pointer_for_current_thread(0);
-        std::atomic<void*>& hp1 = get_hazard_pointer_for_current_thread(1);
-        std::atomic<void*>& hp2 = get_hazard_pointer_for_current_thread(2);
+        size_t threads;
 
-        std::atomic<marked_ptr>* prev;
-        marked_ptr curr, next;
+        size_t concurrency() const
+        {
+            return threads;
+        }
 
-        while (true)
+        template <typename F>
+        void operator()(size_t n, F& run) const
         {
-            curr = list_find(head, key, &prev, &next);
-            if ((get_ptr(curr) == nullptr) || get_ptr(curr)->key != key)
-            {
-                result = false;
-                break;
-            }
+            std::vector<std::thread> workers;
+            for (size_t k = 1; k < n; ++k)
+                workers.emplace_back([&run, k]() { run(k); });
+            run(0);
+            for (auto& w : workers)
+                w.join();
+        }
+    };
 
-            marked_ptr n = get_ptr(next);
-            if (!(get_ptr(curr)->next).compare_exchange_strong
-                    (n, set_bit(get_ptr(next), 1)))
-                continue;
+    // то же на задачах планировщика: k = 0 выполняет текущий поток,
+    // остальные - задачи task_group, ожидание помогает их выполнять
+    template <typename E>
+    struct executor_launcher
+    {
+        E& executor;
 
-            marked_ptr cur = get_ptr(curr);
-            if (prev->compare_exchange_strong(cur, get_ptr(next)))
-            {
-                reclaim_later(curr);
-            }
-            else
-            {
-                list_find(head, key, &prev, &next);
-            }
+        size_t concurrency() const
+        {
+            return executor.concurrency() + 1;
+        }
 
-            result = true;
-            break;
+        template <typename F>
+        void operator()(size_t n, F& run) const
+        {
+            task_group<E> g(executor);
+            for (size_t k = 1; k < n; ++k)
+                g.run([&run, k]() { run(k); });
+            run(0);
+            g.wait();
         }
+    };
 
-        hp0.store(nullptr);
-        hp1.store(nullptr);
-        hp2.store(nullptr);
+    template <typename L>
+    hash_table_stats stats_on(L launch)
+    {
+        std::vector<hash_table_stats> partial;
+        for_each_bucket_range(launch, partial,
+                              [&](size_t i, hash_table_stats& s)
+        {
+            s.add_chain(list_for_each(&table[i], [](const K&, const T&) { }));
+        });
 
+        hash_table_stats result;
+        result.buckets = buckets;
+        for (const hash_table_stats& p : partial)
+            result.merge(p);
         return result;
     }
 
-    bool list_search(std::atomic<marked_ptr>* head, K key, T& result)
+    template <typename L, typename F>
+    size_t parallel_for_each_on(L launch, F& f)
     {
-        std::atomic<marked_ptr>* prev;
-        marked_ptr res, next;
+        std::vector<size_t> counts;
+        for_each_bucket_range(launch, counts,
+                              [&](size_t i, size_t& count)
+        {
+            count += list_for_each(&table[i], f);
+        });
 
-        std::atomic<void*>& hp0 = get_hazard_pointer_for_current_thread(0);
-        std::atomic<void*>& hp1 = get_hazard_pointer_for_current_thread(1);
-        std::atomic<void*>& hp2 = get_hazard_pointer_for_current_thread(2);
+        size_t total = 0;
+        for (size_t c : counts)
+            total += c;
+        return total;
+    }
 
-        res = list_find(head, key, &prev, &next);
+    template <typename L, typename V, typename M, typename F, typename G>
+    V parallel_reduce_on(L launch, V init, M& map, F& reduce, G& combine)
+    {
+        std::vector<V> partial;
+        for_each_bucket_range(launch, partial, [&](size_t i, V& acc)
+        {
+            list_for_each(&table[i], [&](const K& k, const T& v)
+            {
+                acc = reduce(acc, map(k, v));
+            });
+        }, init);
 
-        if (get_ptr(res) && (get_ptr(res)->key == key))
+        V result = init;
+        for (V& p : partial)
+            result = combine(result, p);
+        return result;
+    }
+
+    // корзины раздаются исполнителям частями по bucket_chunk,
+    // work(i, state) вызывается для корзины i с состоянием исполнителя
+    // (states[k] создается из init). Исполнителей не больше
+    // launch.concurrency() и числа частей
+    static const size_t bucket_chunk = 64;
+
+    template <typename L, typename S, typename W>
+    void for_each_bucket_range(L& launch, std::vector<S>& states,
+                               W work, const S& init = S())
+    {
+        size_t count = std::max<size_t>(1, std::min(launch.concurrency(),
+                (buckets + bucket_chunk - 1) / bucket_chunk));
+        states.assign(count, init);
+        std::atomic<size_t> next_chunk(0);
+
+        auto run = [&](size_t k)
         {
-            result = get_ptr(res)->data;
+            while (true)
+            {
+                size_t first = next_chunk.fetch_add(bucket_chunk);
+                if (first >= buckets)
+                    break;
+                size_t last = std::min(first + bucket_chunk, buckets);
+                for (size_t i = first; i < last; ++i)
+                    work(i, states[k]);
+            }
+        };
 
-            hp0.store(nullptr);
-            hp1.store(nullptr);
-            hp2.store(nullptr);
+        launch(count, run);
+    }
 
-            return true;
+public:
+    // печать ключей в таблице
+    void print_hash_table()
+    {
+        for (size_t i = 0; i < buckets; ++i)
+        {
+            std::cout << i << " : ";
+            list_for_each(&table[i], [](const K& k, const T&)
+            {
+                std::cout << k.value << " ";
+            });
+
+            std::cout << std::endl;
+        }
+    }
+
+    // получить сумму ключей в таблице
+    int get_sum()
+    {
+        int sum = 0;
+        for (size_t i = 0; i < buckets; ++i)
+        {
+            list_for_each(&table[i], [&sum](const K& k, const T&)
+            {
+                sum += k.value;
+            });
         }
 
-        return false;
+        return sum;
     }
 };
 
@@ -0,0 +1,597 @@
+#ifndef LOCK_FREE_LIST_H
+#define LOCK_FREE_LIST_H
+
+// based on Michael's "High performance dynamic lock-free hash tables
+// and list-based sets"
+
+#include "backoff.h"
+#include "hazard_pointer.h"
+#include "slab_allocator.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// запрос строки кэша заранее, без ожидания: адрес может быть
+// nullptr или уже освобожденным, prefetch не обращается к памяти
+#if defined(__GNUC__)
+#define LOCK_FREE_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define LOCK_FREE_PREFETCH(p) ((void)(p))
+#endif
+
+namespace lock_free {
+
+// упорядоченный lock-free список с помеченными указателями (marked pointers),
+// общая часть lock_free_hash_table и split_ordered_hash_table.
+// R - политика освобождения памяти (hazard_reclamation, epoch_reclamation),
+// C - ожидание после неудачной CAS операции (no_backoff, exponential_backoff,
+// proportional_backoff),
+// A - выделение памяти узлов (global_allocation, slab_allocation)
+template <typename K, typename T, typename R = hazard_reclamation,
+          typename C = no_backoff, typename A = global_allocation>
+class lock_free_list
+{
+protected:
+    using guard = typename R::guard;
+
+    struct node;
+    using marked_ptr = node*;
+
+    struct node: reclaimable
+    {
+        K key;
+        T data;
+        std::atomic<marked_ptr> next;
+
+        // данные создаются сразу в узле
+        template <typename... Args>
+        node(K k, Args&&... args):
+            key(k), data(std::forward<Args>(args)...) { }
+
+        // узел выделяется и удаляется (в том числе отложенно в SMR)
+        // через политику A
+        static void* operator new(size_t size)
+        {
+            return A::allocate(size, alignof(node));
+        }
+
+        static void operator delete(void* p, size_t size)
+        {
+            A::deallocate(p, size, alignof(node));
+        }
+    };
+
+    // marked ptr operations
+    static uintptr_t get_bit(marked_ptr p)
+    {
+        return reinterpret_cast<uintptr_t>(p) & 1;
+    }
+
+    static marked_ptr set_bit(marked_ptr p, uintptr_t bit)
+    {
+        return reinterpret_cast<marked_ptr>(
+                    (reinterpret_cast<uintptr_t>(p)) | bit);
+    }
+
+    static marked_ptr get_ptr(marked_ptr p)
+    {
+        return reinterpret_cast<marked_ptr>((reinterpret_cast<uintptr_t>(p))
+                                            & ~(static_cast<uintptr_t>(1)));
+    }
+
+    // hazard указатели операции: 0 - next, 1 - curr, 2 - prev
+    marked_ptr list_find(guard& g, std::atomic<marked_ptr>* head, K key,
+                   std::atomic<marked_ptr>** out_prev, marked_ptr* out_next)
+    {
+        std::atomic<marked_ptr>* prev;
+        marked_ptr curr, next;
+
+        C backoff;
+
+        try_again:
+
+        prev = head;
+        curr = (*prev).load();
+        next = nullptr;
+
+        // curr защищен, только если после объявления
+        // он все еще следует за prev
+        g.protect(1, curr);
+        if ((*prev).load() != curr)
+        {
+            backoff();
+            goto try_again;
+        }
+
+        while (true)
+        {
+            if (get_ptr(curr) == nullptr)
+                goto done;
+
+            // в hazard указателях храним адреса без пометки
+            next = get_ptr(curr)->next.load();
+            g.protect(0, get_ptr(next));
+            if (get_ptr(curr)->next.load() != next)
+            {
+                backoff();
+                goto try_again;
+            }
+
+            K ckey = get_ptr(curr)->key;
+
+            if ((*prev).load() != curr)
+            {
+                backoff();
+                goto try_again;
+            }
+
+            if (!get_bit(next))
+            {
+                if (ckey >= key)
+                    goto done;
+
+                prev=&(get_ptr(curr)->next);
+                g.protect(2, curr);
+            } else
+            {
+                marked_ptr cur = get_ptr(curr);
+                if (prev->compare_exchange_strong(cur, get_ptr(next)))
+                {
+                    R::retire(curr);
+                }
+                else
+                {
+                    backoff();
+                    goto try_again;
+                }
+            }
+
+            curr = get_ptr(next);
+            g.protect(1, curr);
+        }
+
+        done:
+
+        *out_prev = prev;
+        *out_next = next;
+        return curr;
+    }
+
+    bool list_insert(std::atomic<marked_ptr>* head, marked_ptr new_node)
+    {
+        guard g;
+        C backoff;
+
+        K key = new_node->key;
+        bool result = false;
+
+        std::atomic<marked_ptr>* prev;
+        marked_ptr curr, next;
+
+        while (true)
+        {
+            curr = list_find(g, head, key, &prev, &next);
+
+            if (get_ptr(curr) != nullptr)
+            {
+                if (get_ptr(curr)->key == key)
+                {
+                    result = false;
+                    break;
+                }
+            }
+
+            new_node->next.store(get_ptr(curr));
+            marked_ptr cur = get_ptr(curr);
+            if (prev->compare_exchange_strong(cur, get_ptr(new_node)))
+            {
+                result = true;
+                break;
+            }
+            backoff();
+        }
+
+        return result;
+    }
+
+    bool list_delete(std::atomic<marked_ptr>* head, K key)
+    {
+        bool result = false;
+        guard g;
+        C backoff;
+
+        std::atomic<marked_ptr>* prev;
+        marked_ptr curr, next;
+
+        while (true)
+        {
+            curr = list_find(g, head, key, &prev, &next);
+            if ((get_ptr(curr) == nullptr) || get_ptr(curr)->key != key)
+            {
+                result = false;
+                break;
+            }
+
+            marked_ptr n = get_ptr(next);
+            if (!(get_ptr(curr)->next).compare_exchange_strong
+                    (n, set_bit(get_ptr(next), 1)))
+            {
+                backoff();
+                continue;
+            }
+
+            marked_ptr cur = get_ptr(curr);
+            if (prev->compare_exchange_strong(cur, get_ptr(next)))
+            {
+                R::retire(curr);
+            }
+            else
+            {
+                list_find(g, head, key, &prev, &next);
+            }
+
+            result = true;
+            break;
+        }
+
+        return result;
+    }
+
+    // позиция обхода списка: curr - последний выданный узел,
+    // он защищен hazard указателем 3 (указатели 0-2 свободны для
+    // операций над контейнерами между шагами обхода)
+    struct list_cursor
+    {
+        std::atomic<marked_ptr>* head;
+        marked_ptr curr;
+        // ключ curr, пройденные ключи не больше него
+        K last;
+        bool has_last;
+
+        explicit list_cursor(std::atomic<marked_ptr>* h):
+            head(h), curr(nullptr), last(), has_last(false) { }
+    };
+
+    // переход к следующему неудаленному узлу списка по возрастанию
+    // ключей, false - конец списка. Помеченные узлы вырезаются, как
+    // в list_find. Если текущий узел удалили, обход начинается с головы
+    // и пропускает уже пройденные ключи, поэтому каждый ключ встречается
+    // не больше одного раза (weakly consistent).
+    // hazard указатели: 2 - next, 3 - curr, 4 - prev
+    bool list_next(guard& g, list_cursor& c)
+    {
+        std::atomic<marked_ptr>* prev;
+        marked_ptr curr, next;
+
+        C backoff;
+
+        if (c.curr != nullptr)
+        {
+            g.protect(4, c.curr);
+            prev = &c.curr->next;
+        }
+        else
+            prev = c.head;
+        goto start;
+
+        try_again:
+
+        backoff();
+        prev = c.head;
+
+        start:
+
+        curr = (*prev).load();
+        // предыдущий узел удален, его next больше не меняется
+        if (get_bit(curr))
+            goto try_again;
+        g.protect(3, curr);
+        if ((*prev).load() != curr)
+            goto try_again;
+
+        while (true)
+        {
+            if (curr == nullptr)
+            {
+                c.curr = nullptr;
+                return false;
+            }
+
+            next = curr->next.load();
+            g.protect(2, get_ptr(next));
+            if (curr->next.load() != next)
+                goto try_again;
+            if ((*prev).load() != curr)
+                goto try_again;
+
+            if (!get_bit(next))
+            {
+                if (!c.has_last || !(c.last >= curr->key))
+                {
+                    c.last = curr->key;
+                    c.has_last = true;
+                    c.curr = curr;
+                    return true;
+                }
+
+                prev = &curr->next;
+                g.protect(4, curr);
+            }
+            else
+            {
+                marked_ptr cur = curr;
+                if (prev->compare_exchange_strong(cur, get_ptr(next)))
+                    R::retire(curr);
+                else
+                    goto try_again;
+            }
+
+            curr = get_ptr(next);
+            g.protect(3, curr);
+        }
+    }
+
+    // f(const K&, const T&) для каждого неудаленного узла списка,
+    // узел защищен от удаления на время вызова. Возвращает число узлов
+    template <typename F>
+    size_t list_for_each(std::atomic<marked_ptr>* head, F&& f)
+    {
+        guard g;
+        list_cursor c(head);
+        size_t count = 0;
+        while (list_next(g, c))
+        {
+            f(static_cast<const K&>(c.curr->key),
+              static_cast<const T&>(c.curr->data));
+            ++count;
+        }
+        return count;
+    }
+
+    enum assign_result { assign_declined, assign_inserted, assign_replaced };
+
+    // запись нового значения ключа key одной CAS операцией.
+    // make(const T* current, node* spare) возвращает узел с новым
+    // значением: current - текущее значение (nullptr - ключа нет),
+    // spare - узел прошлой неудачной попытки (nullptr в первой), его
+    // можно вернуть снова; nullptr - отказ от записи.
+    // Если ключ есть, новый узел ставится за текущим, и та же CAS
+    // помечает текущий удаленным: ключ не пропадает из списка,
+    // а читатели, уже дошедшие до текущего узла, видят старое значение
+    template <typename F>
+    assign_result list_assign(std::atomic<marked_ptr>* head, K key, F&& make)
+    {
+        guard g;
+        C backoff;
+
+        std::atomic<marked_ptr>* prev;
+        marked_ptr curr, next;
+        node* spare = nullptr;
+
+        while (true)
+        {
+            curr = list_find(g, head, key, &prev, &next);
+            node* found = get_ptr(curr);
+            if (found != nullptr && found->key != key)
+                found = nullptr;
+
+            // current защищен hazard указателем curr
+            node* new_node = make(found ? &found->data : nullptr, spare);
+            if (new_node != spare)
+                delete spare;
+            spare = new_node;
+            if (new_node == nullptr)
+                return assign_declined;
+
+            if (found == nullptr)
+            {
+                new_node->next.store(get_ptr(curr));
+                marked_ptr cur = get_ptr(curr);
+                if (prev->compare_exchange_strong(cur, new_node))
+                    return assign_inserted;
+            }
+            else
+            {
+                new_node->next.store(get_ptr(next));
+                marked_ptr n = get_ptr(next);
+                if (found->next.compare_exchange_strong(n, set_bit(new_node, 1)))
+                {
+                    // вырезаем замененный узел, как при удалении
+                    marked_ptr cur = found;
+                    if (prev->compare_exchange_strong(cur, new_node))
+                        R::retire(found);
+                    else
+                        list_find(g, head, key, &prev, &next);
+                    return assign_replaced;
+                }
+            }
+
+            backoff();
+        }
+    }
+
+    // f(const T&) вызывается для найденного элемента без копирования,
+    // пока узел защищен от удаления
+    template <typename F>
+    bool list_visit(std::atomic<marked_ptr>* head, K key, F&& f)
+    {
+        std::atomic<marked_ptr>* prev;
+        marked_ptr res, next;
+
+        guard g;
+
+        res = list_find(g, head, key, &prev, &next);
+
+        if (get_ptr(res) && (get_ptr(res)->key == key))
+        {
+            f(static_cast<const T&>(get_ptr(res)->data));
+            return true;
+        }
+
+        return false;
+    }
+
+    bool list_search(std::atomic<marked_ptr>* head, K key, T& result)
+    {
+        return list_visit(head, key, [&result](const T& data)
+        {
+            result = data;
+        });
+    }
+
+    // число ключей, поиск которых идет одновременно
+    static const size_t batch_group = 16;
+
+    // поиск n <= batch_group ключей, heads[i] - голова списка keys[i],
+    // ее строка кэша уже запрошена. Сначала запрашиваются первые узлы
+    // всех списков, затем цепочки обходятся по одному узлу каждого ключа
+    // за шаг с запросом следующего узла, так что промахи кэша разных
+    // ключей перекрываются (group prefetching).
+    // Если guard политики R защищает все прочитанные узлы (эпохи), обход
+    // идет под одним guard на всю группу без вырезания помеченных узлов.
+    // С hazard указателями у каждого ключа два групповых указателя
+    // guard (protect_group): текущий узел и следующий, который
+    // объявляется и проверяется по next текущего, как в list_find.
+    // Помеченный узел так пройти нельзя (его next может указывать
+    // на уже освобожденный узел), такой ключ ищется заново через
+    // list_find, который вырезает помеченные узлы.
+    // Возвращает число найденных ключей
+    size_t list_search_group(std::atomic<marked_ptr>** heads, const K* keys,
+                             size_t n, T* results, bool* found)
+    {
+        static_assert(2 * batch_group <= max_group_hp,
+                      "group search needs two hazard pointers per key");
+
+        guard g;
+        marked_ptr curr[batch_group];
+        for (size_t i = 0; i < n; ++i)
+        {
+            curr[i] = get_ptr(heads[i]->load());
+            LOCK_FREE_PREFETCH(curr[i]);
+        }
+
+        if (!R::guards_region)
+            return hazard_search_group(g, heads, keys, n, curr,
+                                       results, found);
+
+        size_t count = 0;
+
+        bool done[batch_group] = { };
+        size_t active = n;
+        while (active > 0)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (done[i])
+                    continue;
+
+                marked_ptr c = curr[i];
+                marked_ptr next = c != nullptr ? c->next.load() : nullptr;
+                if (c == nullptr || (!get_bit(next) && c->key >= keys[i]))
+                {
+                    found[i] = c != nullptr && c->key == keys[i];
+                    if (found[i])
+                    {
+                        results[i] = c->data;
+                        ++count;
+                    }
+                    done[i] = true;
+                    --active;
+                    continue;
+                }
+
+                // удаленные узлы пропускаются, их next не меняется
+                curr[i] = get_ptr(next);
+                LOCK_FREE_PREFETCH(curr[i]);
+            }
+        }
+
+        return count;
+    }
+
+    // обход группы под hazard указателями: ключ i держит текущий узел
+    // в групповом указателе 2 * i + slot[i], следующий объявляет в другом
+    size_t hazard_search_group(guard& g, std::atomic<marked_ptr>** heads,
+                               const K* keys, size_t n, marked_ptr* curr,
+                               T* results, bool* found)
+    {
+        unsigned slot[batch_group];
+        bool done[batch_group] = { };
+        bool retry[batch_group] = { };
+        size_t active = n;
+        size_t count = 0;
+
+        // первые узлы: объявляем и проверяем, что голова не изменилась
+        for (size_t i = 0; i < n; ++i)
+        {
+            slot[i] = 0;
+            while (true)
+            {
+                g.protect_group(2 * i, curr[i]);
+                marked_ptr c = heads[i]->load();
+                if (c == curr[i])
+                    break;
+                curr[i] = c;
+            }
+        }
+
+        while (active > 0)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (done[i])
+                    continue;
+
+                marked_ptr c = curr[i];
+                marked_ptr next = c != nullptr ? c->next.load() : nullptr;
+                if (c != nullptr && get_bit(next))
+                {
+                    retry[i] = true;
+                    done[i] = true;
+                    --active;
+                    continue;
+                }
+
+                if (c == nullptr || c->key >= keys[i])
+                {
+                    found[i] = c != nullptr && c->key == keys[i];
+                    if (found[i])
+                    {
+                        results[i] = c->data;
+                        ++count;
+                    }
+                    done[i] = true;
+                    --active;
+                    continue;
+                }
+
+                // next жив, пока c не удален: next узла c
+                // не изменился и не помечен после объявления
+                unsigned other = slot[i] ^ 1;
+                g.protect_group(2 * i + other, next);
+                if (c->next.load() != next)
+                    continue;
+
+                slot[i] = other;
+                curr[i] = next;
+                LOCK_FREE_PREFETCH(next);
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (retry[i])
+            {
+                found[i] = list_search(heads[i], keys[i], results[i]);
+                count += found[i];
+            }
+        }
+        return count;
+    }
+};
+
+} // namespace lock_free
+
+#endif // LOCK_FREE_LIST_H
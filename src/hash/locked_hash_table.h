@@ -8,7 +8,7 @@
 #include <unordered_map>
 #include <mutex>
 
-template <typename K, typename T>
+template <typename K, typename T, typename H = lock_free::hash_compare<K>>
 class lock_based_hash_table
 {
 public:
@@ -34,9 +34,48 @@ public:
         return data.erase(key);
     }
 
+    bool hash_search(K key, T& result)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        auto it = data.find(key);
+        if (it == data.end())
+            return false;
+        result = it->second;
+        return true;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(m);
+        return data.size();
+    }
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> lock(m);
+        return data.empty();
+    }
+
+    double load_factor() const
+    {
+        std::lock_guard<std::mutex> lock(m);
+        return data.load_factor();
+    }
+
+    lock_free::hash_table_stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(m);
+        lock_free::hash_table_stats result;
+        result.buckets = data.bucket_count();
+        for (size_t i = 0; i < data.bucket_count(); ++i)
+            result.add_chain(data.bucket_size(i));
+        return result;
+    }
+
     void print_table()
     {
-        for (size_t i = 0; i < buckets; ++i)
+        std::lock_guard<std::mutex> lock(m);
+        for (size_t i = 0; i < data.bucket_count(); ++i)
         {
             std::cout << i << " : ";
             for (auto it = data.begin(i); it!= data.end(i); ++it)
@@ -50,13 +89,11 @@ public:
 
     int get_sum()
     {
+        std::lock_guard<std::mutex> lock(m);
         int sum = 0;
-        for (size_t i = 0; i < buckets; ++i)
+        for (auto it = data.begin(); it != data.end(); ++it)
         {
-            for (auto it = data.begin(i); it!= data.end(i); ++it)
-            {
-               sum += it->first.value;
-            }
+           sum += it->first.value;
         }
 
         return sum;
@@ -66,7 +103,8 @@ protected:
     size_t buckets;
 
     mutable std::mutex m;
-    std::unordered_map<K, T> data;
+    std::unordered_map<K, T, lock_free::std_hasher<H>,
+                       lock_free::std_key_equal<H>> data;
 };
 
 #endif // LOCKED_HASH_TABLE_H
@@ -0,0 +1,633 @@
+#ifndef OPEN_ADDRESSING_HASH_TABLE_H
+#define OPEN_ADDRESSING_HASH_TABLE_H
+
+#include "backoff.h"
+#include "hash.h"
+#include "hazard_pointer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+
+namespace lock_free {
+
+// хеш-таблица с открытой адресацией и линейным пробированием
+// для тривиально копируемых ключей и значений.
+// Ключ записывается в ячейку один раз, удаление оставляет tombstone.
+// Повторная вставка того же ключа занимает его tombstone и переписывает
+// значение, поэтому при удалениях и вставках одних и тех же ключей
+// ячейки не расходуются. Каждое занятие tombstone увеличивает версию
+// ячейки, поиск копирует значение и сверяет версию (seqlock).
+// При заполнении таблица переносится в новый массив, перенос
+// выполняют совместно все потоки: любой поток может доделать перенос
+// за вытесненный и опубликовать новый массив.
+// Поиск и удаление не ждут другие потоки, поиск читает и замороженные
+// для переноса ячейки. Таблица все же не lock-free: вставка ждет,
+// пока поток, занявший ячейку с тем же отпечатком, допишет ключ;
+// если такой поток вытеснен, вставки ключей с этим отпечатком стоят.
+// При линейном пробировании хеш должен быть хорошо перемешан
+// (hash_compare), иначе последовательные ключи образуют длинные цепочки
+template <typename K, typename T, typename H = hash_compare<K>,
+          typename R = hazard_reclamation, typename C = no_backoff>
+class open_addressing_hash_table
+{
+    static_assert(is_hash_compare<H, K>::value,
+                  "H must provide static hash(key) and equal(key, key)");
+    static_assert(std::is_trivially_copyable<K>::value,
+                  "key must be trivially copyable");
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "value must be trivially copyable");
+
+protected:
+    using guard = typename R::guard;
+
+    // состояние ячейки: биты 0-1 - состояние, 2-4 - флаги,
+    // биты 5..39 - версия (у копии при переносе - номер исходной
+    // ячейки), старшие 24 бита - отпечаток хеша ключа
+    static const uint64_t vacant    = 0;
+    static const uint64_t busy      = 1; // ячейка занята, ключ записывается
+    static const uint64_t full      = 2;
+    static const uint64_t tombstone = 3;
+    static const uint64_t state_mask = 3;
+    static const uint64_t frozen    = 4;  // ячейка заморожена для переноса
+    static const uint64_t moved     = 8;  // ячейка перенесена в новый массив
+    static const uint64_t pinned    = 16; // копия переноса, см. copy_slot
+    static const unsigned version_shift    = 5;
+    static const uint64_t version_unit     = 1ull << version_shift;
+    static const uint64_t version_mask     = 0x000000FFFFFFFFE0ull;
+    static const uint64_t fingerprint_mask = 0xFFFFFF0000000000ull;
+
+    // размер порции ячеек, переносимой одним потоком
+    static const size_t migration_chunk = 64;
+
+    struct slot
+    {
+        std::atomic<uint64_t> ctrl;
+        K key;
+        T value;
+
+        slot(): ctrl(vacant) { }
+    };
+
+    struct array: reclaimable
+    {
+        size_t capacity;
+        size_t mask;
+        slot* slots;
+
+        // число занятых ячеек (вместе с tombstone) и удаленных элементов
+        alignas(128) std::atomic<size_t> claimed;
+        alignas(128) std::atomic<size_t> deleted;
+
+        alignas(128) std::atomic<array*> next;
+        std::atomic<size_t> migrate_index;
+        std::atomic<size_t> migrated;
+
+        array(size_t cap):
+            capacity(cap), mask(cap - 1), slots(new slot[cap]),
+            claimed(0), deleted(0), next(nullptr),
+            migrate_index(0), migrated(0) { }
+
+        // следующий массив принадлежит таблице
+        ~array()
+        {
+            delete[] slots;
+        }
+
+        bool overloaded() const
+        {
+            return claimed.load() >= capacity - capacity / 4;
+        }
+    };
+
+    alignas(128) std::atomic<array*> root;
+
+public:
+    open_addressing_hash_table(size_t capacity = 2 * max_buckets)
+    {
+        size_t cap = 16;
+        while (cap < capacity)
+            cap <<= 1;
+        root.store(new array(cap));
+    }
+
+    open_addressing_hash_table(const open_addressing_hash_table&) = delete;
+    open_addressing_hash_table& operator=(
+            const open_addressing_hash_table&) = delete;
+
+    ~open_addressing_hash_table()
+    {
+        array* a = root.load();
+        while (a != nullptr)
+        {
+            array* next = a->next.load();
+            delete a;
+            a = next;
+        }
+    }
+
+    // hash table operaions
+    bool hash_insert(K key, const T& value)
+    {
+        size_t h = H::hash(key);
+        uint64_t fp = fingerprint(h);
+        guard g;
+        C backoff;
+
+        while (true)
+        {
+            array* a = g.protect(0, root);
+            if (a->overloaded())
+            {
+                help_migrate(g, a);
+                continue;
+            }
+
+            size_t i = h & a->mask;
+            size_t probes = 0;
+            // первый tombstone этого ключа: вставка займет его,
+            // если дальше до пустой ячейки ключа нет
+            slot* reuse = nullptr;
+            uint64_t reuse_ctrl = 0;
+            bool restart = false;
+
+            while (probes < a->capacity)
+            {
+                slot& s = a->slots[i];
+                uint64_t c = s.ctrl.load(std::memory_order_acquire);
+
+                if (c & frozen)
+                    break;
+
+                if ((c & state_mask) == vacant)
+                {
+                    if (reuse != nullptr)
+                    {
+                        // tombstone заняли или заморозили, ищем заново
+                        if (!reuse_tombstone(a, *reuse, reuse_ctrl, value))
+                        {
+                            restart = true;
+                            break;
+                        }
+                        return true;
+                    }
+
+                    // захватываем пустую ячейку
+                    if (!s.ctrl.compare_exchange_strong(c, fp | busy))
+                    {
+                        backoff();
+                        continue;
+                    }
+
+                    a->claimed.fetch_add(1);
+                    s.key = key;
+                    s.value = value;
+
+                    // публикуем, если ячейку не заморозил перенос
+                    uint64_t expected = fp | busy;
+                    if (s.ctrl.compare_exchange_strong(expected, fp | full,
+                                                       std::memory_order_release))
+                        return true;
+
+                    break;
+                }
+
+                if ((c & fingerprint_mask) != fp)
+                {
+                    i = (i + 1) & a->mask;
+                    ++probes;
+                    continue;
+                }
+
+                // ключ с тем же отпечатком еще записывается,
+                // ждем публикации, чтобы не вставить дубликат
+                if ((c & state_mask) == busy)
+                {
+                    backoff();
+                    continue;
+                }
+
+                // ключ ячейки после публикации не меняется
+                if (H::equal(s.key, key))
+                {
+                    if ((c & state_mask) == full)
+                        return false;
+                    // значение копии переноса не переписывается
+                    if (reuse == nullptr && !(c & pinned))
+                    {
+                        reuse = &s;
+                        reuse_ctrl = c;
+                    }
+                }
+
+                i = (i + 1) & a->mask;
+                ++probes;
+            }
+
+            if (restart)
+            {
+                backoff();
+                continue;
+            }
+
+            // массив заполнен или переносится
+            help_migrate(g, a);
+        }
+    }
+
+    bool hash_delete(K key)
+    {
+        size_t h = H::hash(key);
+        uint64_t fp = fingerprint(h);
+        guard g;
+        C backoff;
+
+        while (true)
+        {
+            array* a = g.protect(0, root);
+            int result = find_slot(a, key, h, fp, true,
+                                   [&](slot& s, uint64_t c)
+            {
+                // помечаем элемент удаленным, версия сохраняется
+                while ((c & (fingerprint_mask | frozen | state_mask)) ==
+                       (fp | full))
+                {
+                    if (s.ctrl.compare_exchange_strong(
+                                c, (c & ~state_mask) | tombstone))
+                    {
+                        a->deleted.fetch_add(1);
+                        return 1;
+                    }
+                    backoff();
+                }
+
+                return (c & frozen) ? -1 : 0;
+            });
+
+            if (result >= 0)
+                return result == 1;
+
+            help_migrate(g, a);
+        }
+    }
+
+    bool hash_search(K key, T& result)
+    {
+        size_t h = H::hash(key);
+        uint64_t fp = fingerprint(h);
+        guard g;
+
+        while (true)
+        {
+            array* a = g.protect(0, root);
+            int found = find_slot(a, key, h, fp, false,
+                                  [&](slot& s, uint64_t c)
+            {
+                // ячейку могли удалить и занять снова тем же ключом:
+                // копия годится, если версия не изменилась (seqlock).
+                // Заморозка и перенос значение не меняют
+                result = s.value;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint64_t now = s.ctrl.load(std::memory_order_relaxed);
+                return ((now ^ c) & ~(frozen | moved)) == 0 ? 1 : 2;
+            });
+
+            // 2 - значение изменилось при чтении,
+            // -1 - массив a уже не корень, ищем снова
+            if (found == 0 || found == 1)
+                return found == 1;
+        }
+    }
+
+    size_t capacity() const
+    {
+        return root.load()->capacity;
+    }
+
+    // по счетчикам массива, которые и так ведутся для запуска переноса:
+    // занятые ячейки без tombstone. Во время переноса и при
+    // одновременных изменениях значение приблизительное
+    size_t size() const
+    {
+        guard g;
+        array* a = g.protect(0, root);
+        size_t deleted = a->deleted.load(std::memory_order_relaxed);
+        size_t claimed = a->claimed.load(std::memory_order_relaxed);
+        return claimed > deleted ? claimed - deleted : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // доля занятых ячеек вместе с tombstone: от нее зависит
+    // длина пробирования и по ней запускается перенос
+    double load_factor() const
+    {
+        guard g;
+        array* a = g.protect(0, root);
+        size_t claimed = a->claimed.load(std::memory_order_relaxed);
+        return static_cast<double>(claimed) / a->capacity;
+    }
+
+    // обход текущего массива: elements и used_buckets - заполненные
+    // ячейки, longest_chain - самая длинная серия непустых ячеек
+    // (вместе с tombstone), то есть самое длинное пробирование
+    hash_table_stats stats() const
+    {
+        guard g;
+        array* a = g.protect(0, root);
+
+        hash_table_stats result;
+        result.buckets = a->capacity;
+
+        // обход с пустой ячейки, чтобы не разрезать серию
+        // на границе массива
+        size_t start = 0;
+        while (start < a->capacity &&
+               (a->slots[start].ctrl.load() & state_mask) != vacant)
+            ++start;
+
+        size_t run = 0;
+        for (size_t k = 0; k < a->capacity; ++k)
+        {
+            uint64_t c = a->slots[(start + k) & a->mask].ctrl.load() &
+                         state_mask;
+            if (c == vacant)
+            {
+                run = 0;
+                continue;
+            }
+
+            if (c == full)
+            {
+                ++result.elements;
+                ++result.used_buckets;
+            }
+            if (++run > result.longest_chain)
+                result.longest_chain = run;
+        }
+        return result;
+    }
+
+    // печать ключей в таблице
+    void print_hash_table()
+    {
+        guard g;
+        array* a = g.protect(0, root);
+        for (size_t i = 0; i < a->capacity; ++i)
+        {
+            if ((a->slots[i].ctrl.load() & state_mask) == full)
+                std::cout << i << " : " << a->slots[i].key.value << std::endl;
+        }
+    }
+
+    // получить сумму ключей в таблице
+    int get_sum()
+    {
+        int sum = 0;
+        guard g;
+        array* a = g.protect(0, root);
+        for (size_t i = 0; i < a->capacity; ++i)
+        {
+            if ((a->slots[i].ctrl.load() & state_mask) == full)
+                sum += a->slots[i].key.value;
+        }
+
+        return sum;
+    }
+
+protected:
+    static uint64_t fingerprint(size_t h)
+    {
+        uint64_t v = static_cast<uint64_t>(h);
+        return ((v ^ (v >> 32)) & 0xFFFFFFull) << 40;
+    }
+
+    // поиск заполненной ячейки с ключом key,
+    // возвращает 0 если ключа нет, -1 если массив переносится,
+    // иначе результат visit для найденной ячейки.
+    // Изменение (writer) в замороженной ячейке невозможно, для него
+    // сразу -1. Поиск читает и замороженные ячейки: они больше не
+    // меняются, а новый массив до публикации повторяет старый, поэтому
+    // ответ верен, если a после чтения все еще корень
+    template <typename Visit>
+    int find_slot(array* a, const K& key, size_t h, uint64_t fp,
+                  bool writer, Visit visit)
+    {
+        bool seen_frozen = false;
+        int result = 0;
+        size_t i = h & a->mask;
+        for (size_t probes = 0; probes < a->capacity; ++probes)
+        {
+            slot& s = a->slots[i];
+            uint64_t c = s.ctrl.load(std::memory_order_acquire);
+
+            if (c & frozen)
+            {
+                if (writer)
+                    return -1;
+                seen_frozen = true;
+            }
+            if ((c & state_mask) == vacant)
+                break;
+
+            // незавершенная вставка (busy) еще не произошла,
+            // удаленный ключ мог быть вставлен повторно дальше
+            if ((c & fingerprint_mask) == fp && (c & state_mask) == full &&
+                    H::equal(s.key, key))
+            {
+                result = visit(s, c);
+                break;
+            }
+
+            i = (i + 1) & a->mask;
+        }
+
+        if (seen_frozen && root.load() != a)
+            return -1;
+        return result;
+    }
+
+    // занятие tombstone с ключом вставки: новая версия отличает
+    // новое значение от прежнего для поиска. false - ячейку уже
+    // заняли или заморозили
+    static bool reuse_tombstone(array* a, slot& s, uint64_t c, const T& value)
+    {
+        uint64_t claim = (c & fingerprint_mask) |
+                ((c + version_unit) & version_mask) | busy;
+        if (!s.ctrl.compare_exchange_strong(c, claim))
+            return false;
+
+        a->deleted.fetch_sub(1);
+        s.value = value;
+
+        // если ячейку заморозил перенос, вставка повторяется
+        // в новом массиве, куда ячейка в состоянии busy не попадет
+        uint64_t expected = claim;
+        return s.ctrl.compare_exchange_strong(
+                    expected, (claim & ~state_mask) | full,
+                    std::memory_order_release);
+    }
+
+    void start_migration(array* a)
+    {
+        if (a->next.load() != nullptr)
+            return;
+
+        // живых элементов в новом массиве не больше четверти,
+        // чтобы до следующего переноса осталось место под tombstone
+        size_t claimed = a->claimed.load();
+        size_t deleted = a->deleted.load();
+        size_t live = claimed > deleted ? claimed - deleted : 0;
+
+        size_t cap = a->capacity;
+        while (live * 4 >= cap)
+            cap <<= 1;
+
+        array* n = new array(cap);
+        array* expected = nullptr;
+        if (!a->next.compare_exchange_strong(expected, n))
+            delete n;
+    }
+
+    // копия ячейки s (номер src) массива a в новый массив n.
+    // Копию может начать один поток, а закончить другой: занятая ячейка
+    // хранит номер исходной, и поток, нашедший ее, сам дописывает ключ
+    // и значение из замороженной s. Опоздавший поток может записать их
+    // повторно и после публикации n - те же байты, поэтому копия
+    // помечается pinned: ее значение больше не переписывается
+    // (tombstone копии вставка не занимает)
+    static void copy_slot(array* n, slot& s, size_t src, uint64_t c)
+    {
+        uint64_t fp = c & fingerprint_mask;
+        uint64_t claim = fp | (static_cast<uint64_t>(src) << version_shift) |
+                         pinned | busy;
+        size_t i = H::hash(s.key) & n->mask;
+
+        while (true)
+        {
+            slot& d = n->slots[i];
+            uint64_t e = d.ctrl.load(std::memory_order_acquire);
+
+            if (e == vacant)
+            {
+                if (!d.ctrl.compare_exchange_strong(e, claim))
+                    continue;
+                n->claimed.fetch_add(1);
+                e = claim;
+            }
+
+            if (e == claim)
+            {
+                d.key = s.key;
+                d.value = s.value;
+                d.ctrl.compare_exchange_strong(e, (claim & ~state_mask) | full,
+                                               std::memory_order_release);
+                return;
+            }
+
+            // копия уже есть (и, возможно, удалена после публикации n).
+            // Пустая ячейка здесь бывает только замороженной - копия
+            // тогда давно закончена и стоит раньше по цепочке
+            uint64_t state = e & state_mask;
+            if (state == vacant)
+                return;
+            if ((e & fingerprint_mask) == fp &&
+                    (state == full || state == tombstone) &&
+                    H::equal(d.key, s.key))
+                return;
+
+            i = (i + 1) & n->mask;
+        }
+    }
+
+    // перенос ячейки i: заморозка, копия заполненной ячейки и отметка
+    // moved. Одновременный и повторный перенос ячейки безопасен,
+    // true - отметку поставил этот поток
+    static bool migrate_slot(array* a, array* n, size_t i)
+    {
+        slot& s = a->slots[i];
+        uint64_t c = s.ctrl.load(std::memory_order_acquire);
+        if (!(c & frozen))
+            c = s.ctrl.fetch_or(frozen) | frozen;
+        if (c & moved)
+            return false;
+
+        // после заморозки ячейка меняется только отметкой moved
+        if ((c & state_mask) == full)
+            copy_slot(n, s, i, c);
+        return s.ctrl.compare_exchange_strong(c, c | moved);
+    }
+
+    void publish(array* a, array* n)
+    {
+        array* expected = a;
+        if (root.compare_exchange_strong(expected, n))
+            R::retire(a);
+    }
+
+    // помощь в переносе массива a (защищен hazard указателем 0).
+    // Потоки разбирают порции ячеек, перенесший последнюю ячейку
+    // публикует новый массив. Поток, которому порций не досталось,
+    // не ждет остальных: он проходит весь массив, доделывая порции
+    // вытесненных потоков, и публикует новый массив сам
+    void help_migrate(guard& g, array* a)
+    {
+        start_migration(a);
+        array* n = a->next.load();
+
+        g.protect(1, n);
+        // пока a - корень, новый массив не может быть удален
+        if (root.load() != a)
+        {
+            g.clear(1);
+            return;
+        }
+
+        while (true)
+        {
+            size_t start = a->migrate_index.fetch_add(migration_chunk);
+            if (start >= a->capacity)
+                break;
+
+            size_t end = start + migration_chunk;
+            if (end > a->capacity)
+                end = a->capacity;
+
+            size_t count = 0;
+            for (size_t i = start; i < end; ++i)
+            {
+                if (migrate_slot(a, n, i))
+                    ++count;
+            }
+
+            if (a->migrated.fetch_add(count) + count == a->capacity)
+            {
+                publish(a, n);
+                g.clear(1);
+                return;
+            }
+        }
+
+        // порции разобраны, но их владельцы могли не закончить
+        for (size_t i = 0; i < a->capacity; ++i)
+        {
+            if (i % migration_chunk == 0 && root.load() != a)
+            {
+                g.clear(1);
+                return;
+            }
+            migrate_slot(a, n, i);
+        }
+
+        publish(a, n);
+        g.clear(1);
+    }
+};
+
+} // namespace lock_free
+
+#endif // OPEN_ADDRESSING_HASH_TABLE_H
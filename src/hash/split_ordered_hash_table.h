@@ -0,0 +1,397 @@
+#ifndef SPLIT_ORDERED_HASH_TABLE_H
+#define SPLIT_ORDERED_HASH_TABLE_H
+
+// based on Shalev, Shavit "Split-ordered lists: lock-free extensible
+// hash tables"
+
+#include "hash.h"
+#include "lock_free_list.h"
+#include "striped_counter.h"
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <iostream>
+
+namespace lock_free {
+
+// ключ в split-ordered списке: сначала сравниваются
+// перевернутые биты хеша (split-order), затем сам ключ
+template <typename K>
+struct split_ordered_key
+{
+    uint64_t so;
+    K key;
+
+    split_ordered_key(): so(0), key() { }
+    split_ordered_key(uint64_t s): so(s), key() { }
+    split_ordered_key(uint64_t s, const K& k): so(s), key(k) { }
+
+    // у ключей корзин (sentinel) младший бит нулевой
+    bool is_sentinel() const
+    {
+        return !(so & 1);
+    }
+
+    bool operator == (const split_ordered_key& other) const
+    {
+        return so == other.so && (is_sentinel() || key == other.key);
+    }
+
+    bool operator != (const split_ordered_key& other) const
+    {
+        return !(*this == other);
+    }
+
+    bool operator >= (const split_ordered_key& other) const
+    {
+        if (so != other.so)
+            return so > other.so;
+        return is_sentinel() || key >= other.key;
+    }
+};
+
+// расширяемая lock-free хеш-таблица: все элементы лежат в одном
+// упорядоченном списке, корзины - ссылки на служебные узлы (sentinel)
+// внутри списка. При росте таблицы элементы не перемещаются,
+// новые корзины инициализируются лениво при первом обращении
+template <typename K, typename T, typename H = hash_compare<K>,
+          typename R = hazard_reclamation, typename C = no_backoff,
+          typename A = global_allocation>
+class split_ordered_hash_table:
+        protected lock_free_list<split_ordered_key<K>, T, R, C, A>
+{
+    static_assert(is_hash_compare<H, K>::value,
+                  "H must provide static hash(key) and equal(key, key)");
+
+protected:
+    using so_key = split_ordered_key<K>;
+    using base = lock_free_list<so_key, T, R, C, A>;
+    using typename base::guard;
+    using typename base::node;
+    using typename base::marked_ptr;
+    using base::get_ptr;
+    using base::list_find;
+    using base::list_insert;
+    using base::list_delete;
+    using base::list_search;
+    using base::list_visit;
+    using base::list_for_each;
+
+    // сегмент 0 содержит корзины [0, 2), сегмент s > 0 - [2^s, 2^(s+1))
+    static const size_t max_segments = 48;
+    static const size_t max_size     = static_cast<size_t>(1) << max_segments;
+
+    std::atomic<std::atomic<node*>*> segments[max_segments];
+
+    // сумма счетчика при вставке читается раз в resize_check
+    // вставок потока, в маленькой таблице - при каждой
+    static const size_t resize_check = 64;
+
+    alignas(128) std::atomic<size_t> buckets;
+    striped_counter<> elements;
+    size_t max_load;
+
+public:
+    split_ordered_hash_table(size_t initial_buckets = 2, size_t load = 2):
+        buckets(round_up(initial_buckets)), max_load(load)
+    {
+        for (size_t i = 0; i < max_segments; ++i)
+            segments[i].store(nullptr);
+
+        // корзина 0 - голова всего списка
+        node* head = new node(so_key(0));
+        head->next.store(nullptr);
+        get_slot(0)->store(head);
+    }
+
+    split_ordered_hash_table(const split_ordered_hash_table&) = delete;
+    split_ordered_hash_table& operator=(const split_ordered_hash_table&) = delete;
+
+    ~split_ordered_hash_table()
+    {
+        marked_ptr curr = get_slot(0)->load();
+        while (curr != nullptr)
+        {
+            marked_ptr next = get_ptr(curr->next.load());
+            delete curr;
+            curr = next;
+        }
+
+        for (size_t i = 0; i < max_segments; ++i)
+            delete[] segments[i].load();
+    }
+
+    // hash table operaions
+    bool hash_insert(K key, const T& value)
+    {
+        return hash_emplace(key, value);
+    }
+
+    // при неудаче (ключ уже есть) value остается у вызывающего
+    bool hash_insert(K key, T&& value)
+    {
+        size_t h = H::hash(key);
+        node* new_node = new node(so_key(regular_key(h), key),
+                                  std::move(value));
+        if (insert_node(h, new_node))
+            return true;
+
+        value = std::move(new_node->data);
+        delete new_node;
+        return false;
+    }
+
+    // элемент создается сразу в узле из args
+    template <typename... Args>
+    bool hash_emplace(K key, Args&&... args)
+    {
+        size_t h = H::hash(key);
+        node* new_node = new node(so_key(regular_key(h), key),
+                                  std::forward<Args>(args)...);
+        if (insert_node(h, new_node))
+            return true;
+
+        delete new_node;
+        return false;
+    }
+
+    bool hash_delete(K key)
+    {
+        size_t h = H::hash(key);
+        node* bucket = get_bucket(h & (buckets.load() - 1));
+
+        if (!list_delete(&bucket->next, so_key(regular_key(h), key)))
+            return false;
+
+        elements.decrement();
+        return true;
+    }
+
+    bool hash_search(K key, T& result)
+    {
+        size_t h = H::hash(key);
+        node* bucket = get_bucket(h & (buckets.load() - 1));
+
+        return list_search(&bucket->next, so_key(regular_key(h), key), result);
+    }
+
+    // f(const T&) вызывается для найденного элемента без копирования
+    template <typename F>
+    bool hash_visit(K key, F&& f)
+    {
+        size_t h = H::hash(key);
+        node* bucket = get_bucket(h & (buckets.load() - 1));
+
+        return list_visit(&bucket->next, so_key(regular_key(h), key),
+                          std::forward<F>(f));
+    }
+
+    size_t bucket_count() const
+    {
+        return buckets.load();
+    }
+
+    // число элементов по счетчику, при одновременных изменениях
+    // приблизительное. Точный подсчет обходом - stats()
+    size_t size() const
+    {
+        return elements.size();
+    }
+
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    double load_factor() const
+    {
+        return static_cast<double>(size()) / bucket_count();
+    }
+
+    // обход всего списка под защитой SMR: цепочки - серии элементов
+    // между соседними sentinel узлами, корзины без sentinel
+    // (еще не инициализированные) входят в цепочку родительской
+    hash_table_stats stats()
+    {
+        hash_table_stats result;
+        result.buckets = bucket_count();
+        size_t chain = 0;
+        list_for_each(&get_slot(0)->load()->next,
+                      [&](const so_key& k, const T&)
+        {
+            if (k.is_sentinel())
+            {
+                result.add_chain(chain);
+                chain = 0;
+            }
+            else
+                ++chain;
+        });
+        result.add_chain(chain);
+        return result;
+    }
+
+    // печать ключей в таблице, удаленные узлы пропускаются
+    void print_hash_table()
+    {
+        std::cout << 0 << " : ";
+        list_for_each(&get_slot(0)->load()->next,
+                      [](const so_key& k, const T&)
+        {
+            if (k.is_sentinel())
+                std::cout << std::endl << reverse_bits(k.so) << " : ";
+            else
+                std::cout << k.key.value << " ";
+        });
+
+        std::cout << std::endl;
+    }
+
+    // получить сумму ключей в таблице
+    int get_sum()
+    {
+        int sum = 0;
+        list_for_each(&get_slot(0)->load()->next,
+                      [&sum](const so_key& k, const T&)
+        {
+            if (!k.is_sentinel())
+                sum += k.key.value;
+        });
+
+        return sum;
+    }
+
+protected:
+    static size_t round_up(size_t n)
+    {
+        size_t s = 2;
+        while (s < n && s < max_size)
+            s <<= 1;
+        return s;
+    }
+
+    static uint64_t reverse_bits(uint64_t v)
+    {
+        v = ((v >> 1)  & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+        v = ((v >> 2)  & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+        v = ((v >> 4)  & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+        v = ((v >> 8)  & 0x00FF00FF00FF00FFull) | ((v & 0x00FF00FF00FF00FFull) << 8);
+        v = ((v >> 16) & 0x0000FFFF0000FFFFull) | ((v & 0x0000FFFF0000FFFFull) << 16);
+        return (v >> 32) | (v << 32);
+    }
+
+    // у обычных ключей старший бит хеша выставляется в 1,
+    // после переворота он становится младшим
+    static uint64_t regular_key(size_t h)
+    {
+        return reverse_bits(static_cast<uint64_t>(h) | (1ull << 63));
+    }
+
+    static uint64_t sentinel_key(size_t bucket)
+    {
+        return reverse_bits(static_cast<uint64_t>(bucket));
+    }
+
+    // номер старшего единичного бита
+    static size_t highest_bit(size_t v)
+    {
+#if defined(__GNUC__)
+        return sizeof(unsigned long long) * 8 - 1 -
+               static_cast<size_t>(__builtin_clzll(v));
+#else
+        size_t r = 0;
+        while (v >>= 1)
+            ++r;
+        return r;
+#endif
+    }
+
+    // ячейка каталога корзин, сегменты выделяются лениво
+    std::atomic<node*>* get_slot(size_t bucket)
+    {
+        size_t segment = bucket < 2 ? 0 : highest_bit(bucket);
+        size_t segment_size = segment == 0 ? 2 : static_cast<size_t>(1) << segment;
+        size_t offset = segment == 0 ? bucket : bucket - segment_size;
+
+        std::atomic<node*>* s = segments[segment].load();
+        if (s == nullptr)
+        {
+            std::atomic<node*>* new_segment = new std::atomic<node*>[segment_size];
+            for (size_t i = 0; i < segment_size; ++i)
+                new_segment[i].store(nullptr);
+
+            if (segments[segment].compare_exchange_strong(s, new_segment))
+                s = new_segment;
+            else
+                delete[] new_segment;
+        }
+
+        return &s[offset];
+    }
+
+    // вставка узла в корзину хеша h,
+    // при превышении средней длины цепочки удваиваем число корзин,
+    // новые корзины отделятся от старых при первом обращении
+    bool insert_node(size_t h, node* new_node)
+    {
+        node* bucket = get_bucket(h & (buckets.load() - 1));
+        if (!list_insert(&bucket->next, new_node))
+            return false;
+
+        size_t s = buckets.load();
+        int64_t stripe = elements.add(1);
+        if (s < max_size &&
+                (s * max_load <= resize_check || stripe % resize_check == 0) &&
+                elements.sum() > static_cast<int64_t>(s * max_load))
+            buckets.compare_exchange_strong(s, s * 2);
+
+        return true;
+    }
+
+    node* get_bucket(size_t bucket)
+    {
+        node* sentinel = get_slot(bucket)->load();
+        if (sentinel == nullptr)
+            sentinel = initialize_bucket(bucket);
+        return sentinel;
+    }
+
+    // вставка sentinel узла корзины после sentinel родительской корзины
+    // (номер корзины без старшего бита)
+    node* initialize_bucket(size_t bucket)
+    {
+        size_t parent = bucket & ~(static_cast<size_t>(1) << highest_bit(bucket));
+        node* parent_sentinel = get_bucket(parent);
+
+        so_key key(sentinel_key(bucket));
+        node* sentinel = new node(key);
+        if (!list_insert(&parent_sentinel->next, sentinel))
+        {
+            // корзину уже инициализировал другой поток,
+            // sentinel узлы не удаляются, поэтому защита после поиска не нужна
+            delete sentinel;
+
+            guard g;
+            std::atomic<marked_ptr>* prev;
+            marked_ptr next;
+            sentinel = get_ptr(list_find(g, &parent_sentinel->next, key,
+                                         &prev, &next));
+        }
+
+        get_slot(bucket)->store(sentinel);
+        return sentinel;
+    }
+};
+
+} // namespace lock_free
+
+#endif // SPLIT_ORDERED_HASH_TABLE_H
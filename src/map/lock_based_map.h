@@ -0,0 +1,99 @@
+#ifndef LOCK_BASED_MAP_H
+#define LOCK_BASED_MAP_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <utility>
+
+namespace lock_free {
+
+// упорядоченный словарь с блокировкой чтения-записи
+// (std::map + std::shared_mutex), интерфейс как у lock_free_skip_list
+template <typename K, typename T>
+class lock_based_map
+{
+public:
+    bool insert(K key, const T& value)
+    {
+        std::unique_lock<std::shared_mutex> lock(m);
+        return data.emplace(key, value).second;
+    }
+
+    bool insert(K key, T&& value)
+    {
+        std::unique_lock<std::shared_mutex> lock(m);
+        return data.emplace(key, std::move(value)).second;
+    }
+
+    template <typename... Args>
+    bool emplace(K key, Args&&... args)
+    {
+        std::unique_lock<std::shared_mutex> lock(m);
+        return data.emplace(std::piecewise_construct,
+                            std::forward_as_tuple(key),
+                            std::forward_as_tuple(
+                                std::forward<Args>(args)...)).second;
+    }
+
+    bool erase(K key)
+    {
+        std::unique_lock<std::shared_mutex> lock(m);
+        return data.erase(key) != 0;
+    }
+
+    bool find(K key, T& result)
+    {
+        std::shared_lock<std::shared_mutex> lock(m);
+        auto it = data.find(key);
+        if (it == data.end())
+            return false;
+        result = it->second;
+        return true;
+    }
+
+    template <typename F>
+    bool visit(K key, F&& f)
+    {
+        std::shared_lock<std::shared_mutex> lock(m);
+        auto it = data.find(key);
+        if (it == data.end())
+            return false;
+        f(static_cast<const T&>(it->second));
+        return true;
+    }
+
+    // весь просмотр под блокировкой чтения
+    template <typename F>
+    size_t for_each(K from, K to, F&& f)
+    {
+        std::shared_lock<std::shared_mutex> lock(m);
+        size_t count = 0;
+        for (auto it = data.lower_bound(from);
+             it != data.end() && it->first < to; ++it, ++count)
+            f(it->first, static_cast<const T&>(it->second));
+        return count;
+    }
+
+    size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(m);
+        return data.size();
+    }
+
+    bool empty() const
+    {
+        std::shared_lock<std::shared_mutex> lock(m);
+        return data.empty();
+    }
+
+protected:
+    mutable std::shared_mutex m;
+    std::map<K, T> data;
+};
+
+} // namespace lock_free
+
+#endif // LOCK_BASED_MAP_H
@@ -0,0 +1,562 @@
+#ifndef LOCK_FREE_SKIP_LIST_H
+#define LOCK_FREE_SKIP_LIST_H
+
+// based on Fraser's "Practical lock-freedom", ch. 4 and
+// Herlihy, Shavit. The art of multiprocessor programming, ch. 14.4
+
+#include "backoff.h"
+#include "epoch_based.h"
+#include "striped_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <utility>
+
+namespace lock_free {
+
+// упорядоченный lock-free словарь на списке с пропусками (skip list).
+// Узел удаляется пометкой указателей next на всех своих уровнях
+// (marked pointers, как в lock_free_list), сверху вниз; пометка нижнего
+// уровня - момент удаления. Помеченные узлы вырезаются из уровней
+// при поиске. Узел отправляется в retire, когда вставляющий и
+// удаляющий потоки закончили с ним работать.
+// Поиск держит в руках предшественников на всех уровнях, поэтому
+// R - только политика, guard которой защищает все прочитанные узлы
+// (epoch_reclamation); hazard указателей на это не хватит.
+// C - ожидание после неудачной CAS операции
+template <typename K, typename T, typename R = epoch_reclamation,
+          typename C = no_backoff>
+class lock_free_skip_list
+{
+    static_assert(R::guards_region,
+                  "lock_free_skip_list needs a reclamation policy whose "
+                  "guard protects every node read (epoch_reclamation)");
+
+protected:
+    struct node;
+    using marked_ptr = node*;
+    using guard = typename R::guard;
+
+public:
+    // наибольшее число уровней, хватает на 2^24 элементов
+    static const unsigned max_level = 24;
+
+    class range_view;
+
+    lock_free_skip_list(): levels(1)
+    {
+        for (unsigned i = 0; i < max_level; ++i)
+            head[i].store(nullptr);
+    }
+
+    lock_free_skip_list(const lock_free_skip_list&) = delete;
+    lock_free_skip_list& operator=(const lock_free_skip_list&) = delete;
+
+    ~lock_free_skip_list()
+    {
+        // узлы нижнего уровня, включая помеченные и еще не вырезанные;
+        // вырезанные уже переданы R::retire
+        marked_ptr curr = get_ptr(head[0].load());
+        while (curr != nullptr)
+        {
+            marked_ptr next = get_ptr(curr->next(0).load());
+            delete curr;
+            curr = next;
+        }
+    }
+
+    bool insert(K key, const T& value)
+    {
+        return emplace(key, value);
+    }
+
+    bool insert(K key, T&& value)
+    {
+        return emplace(key, std::move(value));
+    }
+
+    // элемент создается сразу в узле, false - ключ уже есть
+    template <typename... Args>
+    bool emplace(K key, Args&&... args)
+    {
+        unsigned top = random_level();
+        node* new_node = new (top) node(top, key, std::forward<Args>(args)...);
+        raise_levels(top);
+
+        guard g;
+        C backoff;
+        node* preds[max_level];
+        node* succs[max_level];
+
+        while (true)
+        {
+            if (find_position(key, preds, succs))
+            {
+                delete new_node;
+                return false;
+            }
+
+            for (unsigned i = 0; i < top; ++i)
+                new_node->next(i).store(succs[i], std::memory_order_relaxed);
+
+            // вставка в нижний уровень - момент добавления
+            marked_ptr expected = succs[0];
+            if (link(preds[0], 0).compare_exchange_strong(expected, new_node))
+                break;
+            backoff();
+        }
+
+        // верхние уровни, пока узел не начали удалять
+        for (unsigned level = 1; level < top; ++level)
+        {
+            while (true)
+            {
+                marked_ptr succ = new_node->next(level).load();
+                if (get_bit(succ))
+                    goto linked;
+                if (succ != succs[level] &&
+                        !new_node->next(level).compare_exchange_strong(
+                            succ, succs[level]))
+                    continue;
+
+                marked_ptr expected = succs[level];
+                if (link(preds[level], level).compare_exchange_strong(
+                            expected, new_node))
+                    break;
+                backoff();
+                find_position(key, preds, succs, new_node);
+            }
+        }
+
+        linked:
+
+        // узел удалили во время вставки: удаляющий поток мог пройти
+        // уровень раньше, чем мы в него вставили
+        if (get_bit(new_node->next(0).load()))
+            find_position(key, preds, succs, new_node);
+        release(new_node);
+        elements.increment();
+        return true;
+    }
+
+    bool erase(K key)
+    {
+        guard g;
+        node* preds[max_level];
+        node* succs[max_level];
+
+        if (!find_position(key, preds, succs))
+            return false;
+
+        node* victim = succs[0];
+        for (unsigned level = victim->levels; level-- > 1;)
+        {
+            marked_ptr succ = victim->next(level).load();
+            while (!get_bit(succ) &&
+                   !victim->next(level).compare_exchange_weak(
+                       succ, set_bit(succ, 1)))
+                ;
+        }
+
+        // пометка нижнего уровня - момент удаления
+        marked_ptr succ = victim->next(0).load();
+        while (true)
+        {
+            // узел удалил другой поток
+            if (get_bit(succ))
+                return false;
+            if (victim->next(0).compare_exchange_weak(succ, set_bit(succ, 1)))
+                break;
+        }
+
+        find_position(key, preds, succs, victim);
+        release(victim);
+        elements.decrement();
+        return true;
+    }
+
+    bool find(K key, T& result)
+    {
+        return visit(key, [&result](const T& data)
+        {
+            result = data;
+        });
+    }
+
+    // f(const T&) вызывается для найденного элемента без копирования,
+    // пока узел защищен от удаления
+    template <typename F>
+    bool visit(K key, F&& f)
+    {
+        guard g;
+        node* curr = lower_node(key);
+        if (curr == nullptr || curr->key != key)
+            return false;
+
+        f(static_cast<const T&>(curr->data));
+        return true;
+    }
+
+    // элементы с ключами из [from, to) в порядке возрастания
+    range_view range(K from, K to)
+    {
+        return range_view(this, from, &to);
+    }
+
+    // элементы с ключами не меньше from
+    range_view lower_bound(K from)
+    {
+        return range_view(this, from, nullptr);
+    }
+
+    // f(const K&, const T&) для элементов с ключами из [from, to)
+    template <typename F>
+    size_t for_each(K from, K to, F&& f)
+    {
+        size_t count = 0;
+        range_view r = range(from, to);
+        for (auto it = r.begin(); it != r.end(); ++it, ++count)
+            f(it.key(), it.value());
+        return count;
+    }
+
+    // число элементов по счетчику (см. striped_counter),
+    // при одновременных изменениях приблизительное
+    size_t size() const
+    {
+        return elements.size();
+    }
+
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
+
+    // есть ли неудаленный узел на нижнем уровне
+    bool empty() const
+    {
+        guard g;
+        node* curr = get_ptr(head[0].load());
+        while (curr != nullptr)
+        {
+            marked_ptr succ = curr->next(0).load();
+            if (!get_bit(succ))
+                break;
+            curr = get_ptr(succ);
+        }
+        return curr == nullptr;
+    }
+
+    // просмотр диапазона под защитой guard: все узлы, до которых
+    // дошел итератор, не освобождаются, пока существует range_view,
+    // поэтому его не стоит держать долго. Просмотр не атомарный:
+    // ключи возрастают, элемент, который был в словаре все время
+    // просмотра, встретится ровно один раз, элементы, добавленные
+    // или удаленные во время просмотра, - может быть
+    class range_view
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = T;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const T*;
+            using reference         = const T&;
+
+            iterator(): curr(nullptr), view(nullptr) { }
+
+            const K& key() const
+            {
+                return curr->key;
+            }
+
+            const T& value() const
+            {
+                return curr->data;
+            }
+
+            const T& operator*() const
+            {
+                return curr->data;
+            }
+
+            const T* operator->() const
+            {
+                return &curr->data;
+            }
+
+            iterator& operator++()
+            {
+                curr = view->bounded(next_live(curr));
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator temp = *this;
+                ++*this;
+                return temp;
+            }
+
+            bool operator==(const iterator& other) const
+            {
+                return curr == other.curr;
+            }
+
+            bool operator!=(const iterator& other) const
+            {
+                return curr != other.curr;
+            }
+
+        protected:
+            friend class range_view;
+
+            node* curr;
+            const range_view* view;
+
+            iterator(node* c, const range_view* v): curr(c), view(v) { }
+        };
+
+        range_view(const range_view&) = delete;
+        range_view& operator=(const range_view&) = delete;
+
+        iterator begin() const
+        {
+            return iterator(first, this);
+        }
+
+        iterator end() const
+        {
+            return iterator(nullptr, this);
+        }
+
+    protected:
+        friend class lock_free_skip_list;
+
+        // guard создается до чтения первого узла
+        guard g;
+        node* first;
+        K last;
+        bool has_last;
+
+        range_view(lock_free_skip_list* list, K from, const K* to):
+            first(nullptr), last(to ? *to : from), has_last(to != nullptr)
+        {
+            first = bounded(list->lower_node(from));
+        }
+
+        node* bounded(node* p) const
+        {
+            return (p != nullptr && has_last && !(p->key < last)) ? nullptr : p;
+        }
+    };
+
+protected:
+    struct node: reclaimable
+    {
+        K key;
+        T data;
+        unsigned levels;
+        // вставляющий и удаляющий потоки,
+        // последний из них отправляет узел в retire
+        std::atomic<unsigned> owners;
+
+        // данные создаются сразу в узле, ссылки уровней
+        // располагаются сразу за узлом
+        template <typename... Args>
+        node(unsigned l, K k, Args&&... args):
+            key(k), data(std::forward<Args>(args)...), levels(l), owners(2)
+        {
+            for (unsigned i = 0; i < levels; ++i)
+                new (&next(i)) std::atomic<marked_ptr>(nullptr);
+        }
+
+        std::atomic<marked_ptr>& next(unsigned i)
+        {
+            return reinterpret_cast<std::atomic<marked_ptr>*>(this + 1)[i];
+        }
+
+        static void* operator new(size_t size, unsigned l)
+        {
+            return ::operator new(size + l * sizeof(std::atomic<marked_ptr>));
+        }
+
+        static void operator delete(void* p, unsigned)
+        {
+            ::operator delete(p);
+        }
+
+        static void operator delete(void* p)
+        {
+            ::operator delete(p);
+        }
+    };
+
+    static_assert(alignof(reclaimable) >= alignof(std::atomic<node*>),
+                  "skip list links must be aligned after the node");
+
+    // marked ptr operations
+    static uintptr_t get_bit(marked_ptr p)
+    {
+        return reinterpret_cast<uintptr_t>(p) & 1;
+    }
+
+    static marked_ptr set_bit(marked_ptr p, uintptr_t bit)
+    {
+        return reinterpret_cast<marked_ptr>(
+                    (reinterpret_cast<uintptr_t>(p)) | bit);
+    }
+
+    static marked_ptr get_ptr(marked_ptr p)
+    {
+        return reinterpret_cast<marked_ptr>((reinterpret_cast<uintptr_t>(p))
+                                            & ~(static_cast<uintptr_t>(1)));
+    }
+
+    // ссылка уровня level узла p, nullptr - голова списка
+    std::atomic<marked_ptr>& link(node* p, unsigned level)
+    {
+        return p != nullptr ? p->next(level) : head[level];
+    }
+
+    // число уровней нового узла: каждый следующий с вероятностью 1/2
+    static unsigned random_level()
+    {
+        unsigned level = 1;
+        size_t r = backoff_random();
+        while ((r & 1) && level < max_level)
+        {
+            ++level;
+            r >>= 1;
+        }
+        return level;
+    }
+
+    // поиск начинается с самого высокого занятого уровня
+    void raise_levels(unsigned top)
+    {
+        unsigned curr = levels.load(std::memory_order_relaxed);
+        while (curr < top && !levels.compare_exchange_weak(curr, top))
+            ;
+    }
+
+    // preds[i] - последний узел уровня i с ключом меньше key
+    // (nullptr - голова), succs[i] - следующий за ним.
+    // Помеченные узлы по пути вырезаются из уровней.
+    // target - узел, который нужно вырезать из всех уровней,
+    // узлы с тем же ключом перед ним пропускаются.
+    // true - на нижнем уровне найден неудаленный узел с ключом key
+    bool find_position(K key, node** preds, node** succs,
+                       node* target = nullptr)
+    {
+        C backoff;
+
+        try_again:
+
+        unsigned top = levels.load();
+        for (unsigned level = max_level; level-- > top;)
+        {
+            preds[level] = nullptr;
+            succs[level] = get_ptr(head[level].load());
+        }
+
+        node* pred = nullptr;
+        for (unsigned level = top; level-- > 0;)
+        {
+            node* curr = get_ptr(link(pred, level).load());
+            while (curr != nullptr)
+            {
+                marked_ptr succ = curr->next(level).load();
+                if (get_bit(succ))
+                {
+                    // curr удаляется, вырезаем его из уровня
+                    marked_ptr expected = curr;
+                    if (!link(pred, level).compare_exchange_strong(
+                                expected, get_ptr(succ)))
+                    {
+                        backoff();
+                        goto try_again;
+                    }
+                    curr = get_ptr(succ);
+                    continue;
+                }
+
+                if (curr->key < key || (target != nullptr &&
+                        curr != target && curr->key == key))
+                {
+                    pred = curr;
+                    curr = get_ptr(succ);
+                }
+                else
+                    break;
+            }
+
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+
+        return succs[0] != nullptr && succs[0]->key == key;
+    }
+
+    // первый неудаленный узел с ключом не меньше key,
+    // помеченные узлы пропускаются без изменения уровней
+    node* lower_node(K key)
+    {
+        node* pred = nullptr;
+        node* curr = nullptr;
+        for (unsigned level = levels.load(); level-- > 0;)
+        {
+            curr = get_ptr(link(pred, level).load());
+            while (curr != nullptr)
+            {
+                marked_ptr succ = curr->next(level).load();
+                if (get_bit(succ))
+                    curr = get_ptr(succ);
+                else if (curr->key < key)
+                {
+                    pred = curr;
+                    curr = get_ptr(succ);
+                }
+                else
+                    break;
+            }
+        }
+        return curr;
+    }
+
+    // следующий неудаленный узел нижнего уровня
+    static node* next_live(node* p)
+    {
+        node* curr = get_ptr(p->next(0).load());
+        while (curr != nullptr)
+        {
+            marked_ptr succ = curr->next(0).load();
+            if (!get_bit(succ))
+                break;
+            curr = get_ptr(succ);
+        }
+        return curr;
+    }
+
+    void release(node* p)
+    {
+        if (p->owners.fetch_sub(1) == 1)
+            R::retire(p);
+    }
+
+    std::atomic<marked_ptr> head[max_level];
+    std::atomic<unsigned> levels;
+    striped_counter<> elements;
+};
+
+} // namespace lock_free
+
+#endif // LOCK_FREE_SKIP_LIST_H
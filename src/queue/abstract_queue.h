@@ -1,14 +1,130 @@
 #ifndef ABSTRACT_QUEUE_H
 #define ABSTRACT_QUEUE_H
 
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
 namespace lock_free {
 
+// статический интерфейс очереди (CRTP): реализации наследуют
+// queue_base<реализация, T> и определяют enqueue/dequeue, операции
+// вызываются напрямую и встраиваются. Пакетные операции по умолчанию
+// поэлементные, реализация может определить свои с тем же именем
+template <typename Derived, typename T>
+class queue_base
+{
+public:
+    using value_type = T;
+
+    // добавление элементов [first, last), возвращает число добавленных
+    size_t enqueue_bulk(const T* first, const T* last)
+    {
+        size_t count = 0;
+        for (; first != last; ++first, ++count)
+        {
+            if (!derived().enqueue(*first))
+                break;
+        }
+        return count;
+    }
+
+    // извлечение до max элементов в out, возвращает число извлеченных
+    size_t dequeue_bulk(T* out, size_t max)
+    {
+        size_t count = 0;
+        while (count < max && derived().dequeue(out[count]))
+            ++count;
+        return count;
+    }
+
+protected:
+    Derived& derived()
+    {
+        return static_cast<Derived&>(*this);
+    }
+};
+
+// проверка, что Q реализует статический интерфейс очереди
+template <typename Q, typename = void>
+struct is_queue: std::false_type { };
+
+template <typename Q>
+struct is_queue<Q, typename std::enable_if<
+        std::is_base_of<queue_base<Q, typename Q::value_type>, Q>::value>::type>:
+        std::true_type { };
+
+// динамический интерфейс очереди, для выбора реализации во время работы
 template <typename T>
 class queue
 {
 public:
+    using value_type = T;
+
+    virtual ~queue() { }
+
     virtual bool enqueue(const T& value) = 0;
+    virtual bool enqueue(T&& value) = 0;
     virtual bool dequeue(T& result) = 0;
+    virtual size_t enqueue_bulk(const T* first, const T* last) = 0;
+    virtual size_t dequeue_bulk(T* out, size_t max) = 0;
+    // приблизительные при одновременных изменениях
+    virtual size_t size() const = 0;
+    virtual bool empty() const = 0;
+};
+
+// адаптер статической реализации Q к динамическому интерфейсу queue<T>
+template <typename Q>
+class queue_adapter final: public queue<typename Q::value_type>
+{
+    static_assert(is_queue<Q>::value,
+                  "Q must derive from lock_free::queue_base<Q, T>");
+
+public:
+    using T = typename Q::value_type;
+
+    bool enqueue(const T& value) override
+    {
+        return impl.enqueue(value);
+    }
+
+    bool enqueue(T&& value) override
+    {
+        return impl.enqueue(std::move(value));
+    }
+
+    bool dequeue(T& result) override
+    {
+        return impl.dequeue(result);
+    }
+
+    size_t enqueue_bulk(const T* first, const T* last) override
+    {
+        return impl.enqueue_bulk(first, last);
+    }
+
+    size_t dequeue_bulk(T* out, size_t max) override
+    {
+        return impl.dequeue_bulk(out, max);
+    }
+
+    size_t size() const override
+    {
+        return impl.size();
+    }
+
+    bool empty() const override
+    {
+        return impl.empty();
+    }
+
+    Q& get()
+    {
+        return impl;
+    }
+
+protected:
+    Q impl;
 };
 
 } // namespace lock_free
@@ -0,0 +1,168 @@
+#ifndef BOUNDED_LOCK_FREE_QUEUE_H
+#define BOUNDED_LOCK_FREE_QUEUE_H
+
+// based on Vyukov's "Bounded MPMC queue"
+// (1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue)
+
+#include "abstract_queue.h"
+#include "backoff.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace lock_free {
+
+// ограниченная lock-free очередь на кольцевом буфере.
+// У каждой ячейки свой номер последовательности:
+// sequence == pos       - ячейка свободна для записи с позиции pos,
+// sequence == pos + 1   - в ячейке данные для чтения с позиции pos.
+// Одна CAS операция на enqueue/dequeue, без списков и указателей.
+// enqueue возвращает false, если очередь заполнена или ячейку
+// следующей позиции еще читает dequeue с прошлого круга.
+// N - степень двойки,
+// C - ожидание после неудачной CAS операции (no_backoff, exponential_backoff,
+// proportional_backoff)
+template <typename T, size_t N = 128, typename C = no_backoff>
+class bounded_lock_free_queue:
+        public queue_base<bounded_lock_free_queue<T, N, C>, T>
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0,
+                  "bounded_lock_free_queue size must be a power of two");
+
+public:
+    bounded_lock_free_queue()
+    {
+        for (size_t i = 0; i < N; ++i)
+            buffer[i].sequence.store(i, std::memory_order_relaxed);
+
+        enqueue_pos.store(0, std::memory_order_relaxed);
+        dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    bool enqueue(const T& value)
+    {
+        return put(value);
+    }
+
+    bool enqueue(T&& value)
+    {
+        return put(std::move(value));
+    }
+
+    bool dequeue(T& result)
+    {
+        C backoff;
+        cell* c;
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            c = &buffer[pos & mask];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) -
+                    static_cast<intptr_t>(pos + 1);
+
+            if (diff == 0)
+            {
+                // в ячейке данные, пробуем занять позицию
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    break;
+                backoff();
+            } else if (diff < 0)
+            {
+                // данные еще не записаны, очередь пуста
+                return false;
+            } else
+            {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        // позиция занята, ячейка принадлежит только этому потоку
+        result = std::move(c->data);
+        // освобождаем ячейку для enqueue на следующем круге
+        c->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // разность позиций: занятые позиции, в том числе еще не
+    // дописанные или не дочитанные ячейки
+    size_t size() const
+    {
+        size_t dequeued = dequeue_pos.load(std::memory_order_relaxed);
+        size_t enqueued = enqueue_pos.load(std::memory_order_relaxed);
+        intptr_t size = static_cast<intptr_t>(enqueued - dequeued);
+        if (size < 0)
+            return 0;
+        return size > static_cast<intptr_t>(N) ? N : size;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+protected:
+    static const size_t mask = N - 1;
+
+    struct cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    // позиции записи и чтения в разных кэш-линиях
+    alignas(128) std::atomic<size_t> enqueue_pos;
+    alignas(128) std::atomic<size_t> dequeue_pos;
+
+    alignas(128) cell buffer[N];
+
+    template <typename V>
+    bool put(V&& value)
+    {
+        C backoff;
+        cell* c;
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            c = &buffer[pos & mask];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) -
+                    static_cast<intptr_t>(pos);
+
+            if (diff == 0)
+            {
+                // ячейка свободна, пробуем занять позицию
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    break;
+                backoff();
+            } else if (diff < 0)
+            {
+                // ячейку еще не освободили на предыдущем круге:
+                // очередь заполнена, либо поток, занявший эту позицию
+                // для dequeue, еще не закончил чтение. Ждать его нельзя -
+                // вытесненный потребитель остановил бы всех производителей,
+                // поэтому в обоих случаях enqueue не удается
+                return false;
+            } else
+            {
+                // позицию заняли другие потоки
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        c->data = std::forward<V>(value);
+        // публикуем данные для dequeue с позиции pos
+        c->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+} // namespace lock_free
+
+#endif // BOUNDED_LOCK_FREE_QUEUE_H
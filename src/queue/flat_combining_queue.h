@@ -0,0 +1,169 @@
+#ifndef FLAT_COMBINING_QUEUE_H
+#define FLAT_COMBINING_QUEUE_H
+
+#include "abstract_queue.h"
+#include "flat_combiner.h"
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace lock_free {
+
+// очередь с flat combining: операции потоков выполняет один поток
+// над кольцевым буфером, который растет вдвое при заполнении.
+// N - число ячеек публикации запросов
+template <typename T, size_t N = 64>
+class flat_combining_queue: public queue_base<flat_combining_queue<T, N>, T>
+{
+public:
+    flat_combining_queue(): buffer(initial_capacity), head(0), length(0),
+        count(0) { }
+
+    bool enqueue(const T& value)
+    {
+        request r(enqueue_copy);
+        r.first = &value;
+        r.last = &value + 1;
+        return execute(r) != 0;
+    }
+
+    bool enqueue(T&& value)
+    {
+        request r(enqueue_move);
+        r.out = &value;
+        return execute(r) != 0;
+    }
+
+    template <typename... Args>
+    bool emplace(Args&&... args)
+    {
+        T value(std::forward<Args>(args)...);
+        return enqueue(std::move(value));
+    }
+
+    bool dequeue(T& result)
+    {
+        request r(dequeue_items);
+        r.out = &result;
+        r.max = 1;
+        return execute(r) != 0;
+    }
+
+    // все элементы добавляются (извлекаются) одним запросом
+    size_t enqueue_bulk(const T* first, const T* last)
+    {
+        if (first == last)
+            return 0;
+        request r(enqueue_copy);
+        r.first = first;
+        r.last = last;
+        return execute(r);
+    }
+
+    size_t dequeue_bulk(T* out, size_t max)
+    {
+        if (max == 0)
+            return 0;
+        request r(dequeue_items);
+        r.out = out;
+        r.max = max;
+        return execute(r);
+    }
+
+    // размер, записанный combiner после последнего прохода
+    size_t size() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+protected:
+    // степень двойки
+    static const size_t initial_capacity = 1024;
+
+    enum kind { enqueue_copy, enqueue_move, dequeue_items };
+
+    struct request
+    {
+        kind op;
+        const T* first;
+        const T* last;
+        T* out;
+        size_t max;
+        size_t count;
+
+        request(kind k):
+            op(k), first(nullptr), last(nullptr),
+            out(nullptr), max(0), count(0) { }
+    };
+
+    flat_combiner<request, N> combiner;
+
+    // читаются и изменяются только потоком-combiner
+    std::vector<T> buffer;
+    size_t head;
+    size_t length;
+    // копия length для чтения без блокировки, пишет только combiner
+    std::atomic<size_t> count;
+
+    size_t execute(request& r)
+    {
+        combiner.execute(r, [this](request& q) { apply(q); });
+        return r.count;
+    }
+
+    void apply(request& r)
+    {
+        switch (r.op)
+        {
+        case enqueue_copy:
+            for (const T* p = r.first; p != r.last; ++p)
+                push_back(*p);
+            r.count = r.last - r.first;
+            break;
+        case enqueue_move:
+            push_back(std::move(*r.out));
+            r.count = 1;
+            break;
+        case dequeue_items:
+            for (; r.count < r.max && length > 0; ++r.count)
+            {
+                r.out[r.count] = std::move(buffer[head]);
+                head = (head + 1) & (buffer.size() - 1);
+                --length;
+            }
+            break;
+        }
+        count.store(length, std::memory_order_relaxed);
+    }
+
+    template <typename V>
+    void push_back(V&& value)
+    {
+        if (length == buffer.size())
+            grow();
+        buffer[(head + length) & (buffer.size() - 1)] =
+                std::forward<V>(value);
+        ++length;
+    }
+
+    // элементы переносятся в начало буфера двойного размера
+    void grow()
+    {
+        std::vector<T> bigger(buffer.size() * 2);
+        for (size_t i = 0; i < length; ++i)
+            bigger[i] = std::move(buffer[(head + i) & (buffer.size() - 1)]);
+        buffer.swap(bigger);
+        head = 0;
+    }
+};
+
+} // namespace lock_free
+
+#endif // FLAT_COMBINING_QUEUE_H
@@ -2,16 +2,26 @@
 #define HAZARD_LOCK_FREE_QUEUE_H
 
 #include "abstract_queue.h"
+#include "backoff.h"
 #include "hazard_pointer.h"
+#include "slab_allocator.h"
+#include "striped_counter.h"
 
 #include <atomic>
 #include <memory>
+#include <utility>
 
 namespace lock_free {
 
-// lock-free очередь с использованием опасных указателей (hazard pointers)
-template <typename T>
-class hazard_lock_free_queue : public queue<T>
+// lock-free очередь с использованием опасных указателей (hazard pointers),
+// R - политика освобождения памяти (hazard_reclamation, epoch_reclamation),
+// C - ожидание после неудачной CAS операции (no_backoff, exponential_backoff,
+// proportional_backoff),
+// A - выделение памяти узлов (global_allocation, slab_allocation)
+template <typename T, typename R = hazard_reclamation,
+          typename C = no_backoff, typename A = global_allocation>
+class hazard_lock_free_queue:
+        public queue_base<hazard_lock_free_queue<T, R, C, A>, T>
 {
 public:
     hazard_lock_free_queue()
@@ -24,66 +34,72 @@ public:
         queue_tail.store(p);
     }
 
-    bool enqueue(const T& value) override
+    bool enqueue(const T& value)
     {
-        node* new_node = new node();
-        new_node->data = value;
+        return emplace(value);
+    }
 
-        node* tail;
-        while (true)
-        {
-            std::atomic<void*>& hp = get_hazard_pointer_for_current_thread(0);
-            tail = queue_tail.load();
-            // объявляем tail как hazard указатель
-            hp.store(tail);
-            // проверяем что tail не изменился
-            if (tail != queue_tail.load()) continue;
+    bool enqueue(T&& value)
+    {
+        return emplace(std::move(value));
+    }
 
-            node* next = tail->next.load();
-            if (tail != queue_tail.load()) continue;
+    // элемент создается сразу в узле
+    template <typename... Args>
+    bool emplace(Args&&... args)
+    {
+        node* new_node = new node(std::forward<Args>(args)...);
+        link_chain(new_node, new_node);
+        elements.increment();
+        return true;
+    }
 
-            if (next != nullptr)
-            {
-                // queue_tail указывает не на последний элемент
-                queue_tail.compare_exchange_weak(tail, next);
-                continue;
-            }
+    // цепочка узлов собирается заранее
+    // и присоединяется к концу очереди одной CAS операцией
+    size_t enqueue_bulk(const T* first, const T* last)
+    {
+        if (first == last)
+            return 0;
 
-            node* temp = nullptr;
-            // записываем new_node в tail->next
-            // при условии что tail->next == nullptr
-            if (tail->next.compare_exchange_strong(temp, new_node))
-                          break;
+        node* chain_first = nullptr;
+        node* chain_last = nullptr;
+        for (const T* p = first; p != last; ++p)
+        {
+            node* new_node = new node(*p);
+            if (chain_last)
+                chain_last->next.store(new_node);
+            else
+                chain_first = new_node;
+            chain_last = new_node;
         }
 
-        // пробуем переместить queue_tail на вставленный элемент
-        queue_tail.compare_exchange_strong(tail, new_node);
-        get_hazard_pointer_for_current_thread(0).store(nullptr);
-        return true;
+        link_chain(chain_first, chain_last);
+        elements.add(last - first);
+        return last - first;
     }
 
-    bool dequeue(T& result) override
+    bool dequeue(T& result)
     {
+        typename R::guard g;
+        C backoff;
         node* head;
+        node* next;
 
         while (true)
         {
             // объявляем head и head->next как hazard
-            std::atomic<void*>& hp1 = get_hazard_pointer_for_current_thread(0);
-            std::atomic<void*>& hp2 = get_hazard_pointer_for_current_thread(1);
             head = queue_head.load();
-            hp1.store(head);
+            g.protect(0, head);
             if (head != queue_head.load()) continue;
 
             node* tail = queue_tail.load();
-            node* next = head->next.load();
-            hp2.store(next);
+            next = head->next.load();
+            g.protect(1, next);
             if (head != queue_head.load()) continue;
 
             if (next == nullptr)
             {
                 // пустая очередь
-                hp1.store(nullptr);
                 return false;
             }
 
@@ -94,29 +110,115 @@ public:
                 continue;
             }
 
-            result = next->data;
             // пытаемся передвинуть queue_head на head->next
             if (queue_head.compare_exchange_strong(head, next)) break;
+            backoff();
         }
 
+        // next стал dummy node, его данные больше никто не читает:
+        // перемещаем их один раз после успешного CAS,
+        // next защищен hazard указателем до конца чтения
+        result = std::move(next->data);
+
         // обнуляем hazard указатели
-        get_hazard_pointer_for_current_thread(0).store(nullptr);
-        get_hazard_pointer_for_current_thread(1).store(nullptr);
+        g.clear(0);
+        g.clear(1);
 
         // добавляем dummy node в reclaim_list
-        reclaim_later(head);
+        R::retire(head);
+        elements.decrement();
         return true;
     }
 
+    // число элементов по счетчику (см. striped_counter)
+    size_t size() const
+    {
+        return elements.size();
+    }
+
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
+
+    bool empty() const
+    {
+        typename R::guard g;
+        node* head;
+        do
+        {
+            head = queue_head.load();
+            g.protect(0, head);
+        } while (head != queue_head.load());
+        return head->next.load() == nullptr;
+    }
+
 protected:
-    struct node
+    struct node: reclaimable
     {
         T data;
         std::atomic<node*> next;
+
+        template <typename... Args>
+        node(Args&&... args):
+            data(std::forward<Args>(args)...), next(nullptr) { }
+
+        // узел выделяется и удаляется (в том числе отложенно в SMR)
+        // через политику A
+        static void* operator new(size_t size)
+        {
+            return A::allocate(size, alignof(node));
+        }
+
+        static void operator delete(void* p, size_t size)
+        {
+            A::deallocate(p, size, alignof(node));
+        }
     };
 
+    // добавление цепочки first..last в конец очереди
+    void link_chain(node* first, node* last)
+    {
+        typename R::guard g;
+        C backoff;
+        node* tail;
+        while (true)
+        {
+            tail = queue_tail.load();
+            // объявляем tail как hazard указатель
+            g.protect(0, tail);
+            // проверяем что tail не изменился
+            if (tail != queue_tail.load()) continue;
+
+            node* next = tail->next.load();
+            if (tail != queue_tail.load()) continue;
+
+            if (next != nullptr)
+            {
+                // queue_tail указывает не на последний элемент
+                queue_tail.compare_exchange_weak(tail, next);
+                continue;
+            }
+
+            node* temp = nullptr;
+            // записываем first в tail->next
+            // при условии что tail->next == nullptr
+            if (tail->next.compare_exchange_strong(temp, first))
+                          break;
+            backoff();
+        }
+
+        // пробуем переместить queue_tail на последний вставленный элемент,
+        // если не вышло, его передвинут другие потоки
+        queue_tail.compare_exchange_strong(tail, last);
+    }
+
     std::atomic<node*> queue_head;
     std::atomic<node*> queue_tail;
+    striped_counter<> elements;
 };
 
 } // namespace lock_free
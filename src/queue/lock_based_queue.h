@@ -6,31 +6,74 @@
 #include <list>
 #include <queue>
 #include <mutex>
+#include <utility>
 
 namespace lock_free {
 
 // thread-safe очередь с блокировкой (std::mutex)
 template <typename T>
-class lock_based_queue: public queue<T>
+class lock_based_queue: public queue_base<lock_based_queue<T>, T>
 {
 public:
-    bool enqueue(const T& value) override
+    bool enqueue(const T& value)
     {
         std::lock_guard<std::mutex> lock(m);
         data.push(value);
         return true;
     }
 
-    bool dequeue(T& result) override
+    bool enqueue(T&& value)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        data.push(std::move(value));
+        return true;
+    }
+
+    template <typename... Args>
+    bool emplace(Args&&... args)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        data.emplace(std::forward<Args>(args)...);
+        return true;
+    }
+
+    bool dequeue(T& result)
     {
         std::lock_guard<std::mutex> lock(m);
         if (data.empty())
             return false;
-        result = data.front();
+        result = std::move(data.front());
         data.pop();
         return true;
     }
 
+    // одна блокировка на все элементы
+    size_t enqueue_bulk(const T* first, const T* last)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        for (const T* p = first; p != last; ++p)
+            data.push(*p);
+        return last - first;
+    }
+
+    size_t dequeue_bulk(T* out, size_t max)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        size_t count = 0;
+        for (; count < max && !data.empty(); ++count)
+        {
+            out[count] = std::move(data.front());
+            data.pop();
+        }
+        return count;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(m);
+        return data.size();
+    }
+
     bool empty() const
     {
         std::lock_guard<std::mutex> lock(m);
@@ -0,0 +1,142 @@
+#ifndef MPSC_LOCK_FREE_QUEUE_H
+#define MPSC_LOCK_FREE_QUEUE_H
+
+// based on Vyukov's "Intrusive MPSC node-based queue"
+// (1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue)
+
+#include "abstract_queue.h"
+#include "striped_counter.h"
+
+#include <atomic>
+#include <utility>
+
+namespace lock_free {
+
+// очередь для многих производителей и одного потребителя.
+// enqueue - один exchange без циклов CAS (wait-free),
+// dequeue выполняет только потребитель, без CAS и hazard указателей:
+// узлы удаляет единственный читающий их поток.
+// Пока производитель между exchange и записью next,
+// потребитель видит очередь пустой
+template <typename T>
+class mpsc_lock_free_queue: public queue_base<mpsc_lock_free_queue<T>, T>
+{
+public:
+    mpsc_lock_free_queue()
+    {
+        node* stub = new node();
+        queue_head = stub;
+        queue_tail.store(stub);
+    }
+
+    ~mpsc_lock_free_queue()
+    {
+        while (queue_head != nullptr)
+        {
+            node* next = queue_head->next.load();
+            delete queue_head;
+            queue_head = next;
+        }
+    }
+
+    bool enqueue(const T& value)
+    {
+        return emplace(value);
+    }
+
+    bool enqueue(T&& value)
+    {
+        return emplace(std::move(value));
+    }
+
+    // элемент создается сразу в узле
+    template <typename... Args>
+    bool emplace(Args&&... args)
+    {
+        node* new_node = new node(std::forward<Args>(args)...);
+
+        // занимаем место в конце очереди и связываем с предыдущим
+        node* prev = queue_tail.exchange(new_node);
+        prev->next.store(new_node, std::memory_order_release);
+        elements.increment();
+        return true;
+    }
+
+    // цепочка связывается заранее, к очереди
+    // присоединяется одним exchange
+    size_t enqueue_bulk(const T* first, const T* last)
+    {
+        if (first == last)
+            return 0;
+
+        node* chain_first = new node(*first);
+        node* chain_last = chain_first;
+        for (const T* p = first + 1; p != last; ++p)
+        {
+            node* new_node = new node(*p);
+            chain_last->next.store(new_node, std::memory_order_relaxed);
+            chain_last = new_node;
+        }
+
+        node* prev = queue_tail.exchange(chain_last);
+        prev->next.store(chain_first, std::memory_order_release);
+        elements.add(last - first);
+        return last - first;
+    }
+
+    // вызывается только потоком-потребителем
+    bool dequeue(T& result)
+    {
+        node* head = queue_head;
+        node* next = head->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+            return false;
+
+        // next становится новым dummy node
+        result = std::move(next->data);
+        queue_head = next;
+        delete head;
+        elements.decrement();
+        return true;
+    }
+
+    // число элементов по счетчику (см. striped_counter),
+    // может вызываться любым потоком
+    size_t size() const
+    {
+        return elements.size();
+    }
+
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+protected:
+    struct node
+    {
+        T data;
+        std::atomic<node*> next;
+
+        template <typename... Args>
+        node(Args&&... args):
+            data(std::forward<Args>(args)...), next(nullptr) { }
+    };
+
+    // queue_head использует только потребитель
+    alignas(128) node* queue_head;
+    alignas(128) std::atomic<node*> queue_tail;
+    striped_counter<> elements;
+};
+
+} // namespace lock_free
+
+#endif // MPSC_LOCK_FREE_QUEUE_H
@@ -0,0 +1,233 @@
+#ifndef SEGMENTED_LOCK_FREE_QUEUE_H
+#define SEGMENTED_LOCK_FREE_QUEUE_H
+
+// based on Ramalhete and Correia's FAAArrayQueue and
+// Morrison and Afek's "Fast concurrent queues for x86 processors" (LCRQ)
+
+#include "abstract_queue.h"
+#include "backoff.h"
+#include "hazard_pointer.h"
+#include "striped_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace lock_free {
+
+// неограниченная lock-free очередь из связанных сегментов.
+// Позиция в сегменте занимается через fetch_add, поэтому потоки
+// не повторяют неудачные CAS на queue_tail/queue_head, как в
+// hazard_lock_free_queue; CAS нужен только при смене сегмента.
+// N - размер сегмента,
+// R - политика освобождения памяти сегментов,
+// C - ожидание после неудачной попытки занять ячейку или добавить сегмент
+// (no_backoff, exponential_backoff, proportional_backoff)
+template <typename T, size_t N = 128, typename R = hazard_reclamation,
+          typename C = no_backoff>
+class segmented_lock_free_queue:
+        public queue_base<segmented_lock_free_queue<T, N, R, C>, T>
+{
+public:
+    segmented_lock_free_queue()
+    {
+        segment* s = new segment();
+        queue_head.store(s);
+        queue_tail.store(s);
+    }
+
+    ~segmented_lock_free_queue()
+    {
+        segment* s = queue_head.load();
+        while (s != nullptr)
+        {
+            segment* next = s->next.load();
+            delete s;
+            s = next;
+        }
+    }
+
+    bool enqueue(const T& value)
+    {
+        return put(value);
+    }
+
+    bool enqueue(T&& value)
+    {
+        return put(std::move(value));
+    }
+
+    bool dequeue(T& result)
+    {
+        typename R::guard g;
+        C backoff;
+
+        while (true)
+        {
+            segment* head = g.protect(0, queue_head);
+
+            // пустая очередь
+            if (head->dequeue_index.load() >= head->enqueue_index.load() &&
+                    head->next.load() == nullptr)
+                return false;
+
+            size_t i = head->dequeue_index.fetch_add(1);
+            if (i < N)
+            {
+                // если enqueue еще не записал данные,
+                // ячейка помечается пропущенной и enqueue займет другую
+                slot& s = head->slots[i];
+                if (s.state.exchange(taken) == full)
+                {
+                    // ячейку больше никто не читает
+                    result = std::move(s.data);
+                    elements.decrement();
+                    return true;
+                }
+                backoff();
+                continue;
+            }
+
+            // сегмент прочитан, переходим к следующему
+            segment* next = head->next.load();
+            if (next == nullptr)
+                return false;
+
+            // queue_tail не должен остаться на удаляемом сегменте
+            segment* tail = head;
+            queue_tail.compare_exchange_strong(tail, next);
+
+            if (queue_head.compare_exchange_strong(head, next))
+                R::retire(head);
+        }
+    }
+
+    // число элементов по счетчику (см. striped_counter): индексы
+    // сегментов включают пропущенные ячейки и по ним размер не считается
+    size_t size() const
+    {
+        return elements.size();
+    }
+
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+protected:
+    // состояния ячейки
+    enum { vacant = 0, full = 1, taken = 2 };
+
+    struct slot
+    {
+        std::atomic<int> state;
+        T data;
+
+        slot(): state(vacant) { }
+    };
+
+    struct segment: reclaimable
+    {
+        // индексы записи и чтения в разных кэш-линиях
+        alignas(128) std::atomic<size_t> enqueue_index;
+        alignas(128) std::atomic<size_t> dequeue_index;
+        alignas(128) std::atomic<segment*> next;
+        slot slots[N];
+
+        segment(): enqueue_index(0), dequeue_index(0), next(nullptr) { }
+
+        // новый сегмент сразу с первым элементом
+        template <typename V>
+        segment(V&& value): segment()
+        {
+            slots[0].data = std::forward<V>(value);
+            slots[0].state.store(full);
+            enqueue_index.store(1);
+        }
+    };
+
+    alignas(128) std::atomic<segment*> queue_head;
+    alignas(128) std::atomic<segment*> queue_tail;
+    striped_counter<> elements;
+
+    // при неудаче перемещенное значение возвращается обратно
+    static void restore(const T&, T&) { }
+    static void restore(T& value, T& data)
+    {
+        value = std::move(data);
+    }
+
+    template <typename V>
+    bool put(V&& value)
+    {
+        typename R::guard g;
+        C backoff;
+
+        while (true)
+        {
+            segment* tail = g.protect(0, queue_tail);
+
+            segment* next = tail->next.load();
+            if (next != nullptr)
+            {
+                // queue_tail указывает не на последний сегмент
+                queue_tail.compare_exchange_strong(tail, next);
+                continue;
+            }
+
+            size_t i = tail->enqueue_index.fetch_add(1);
+            if (i < N)
+            {
+                // позиция наша, публикуем данные,
+                // если dequeue еще не пометил ячейку как пропущенную
+                slot& s = tail->slots[i];
+                s.data = std::forward<V>(value);
+                int expected = vacant;
+                if (s.state.compare_exchange_strong(expected, full))
+                {
+                    elements.increment();
+                    return true;
+                }
+                // ячейку пропустил dequeue, данные из нее не читались
+                restore(value, s.data);
+                backoff();
+                continue;
+            }
+
+            // сегмент заполнен, добавляем новый с элементом в первой ячейке
+            if (tail != queue_tail.load())
+                continue;
+
+            next = tail->next.load();
+            if (next == nullptr)
+            {
+                segment* s = new segment(std::forward<V>(value));
+                if (tail->next.compare_exchange_strong(next, s))
+                {
+                    queue_tail.compare_exchange_strong(tail, s);
+                    elements.increment();
+                    return true;
+                }
+                restore(value, s->slots[0].data);
+                delete s;
+                backoff();
+            }
+            else
+            {
+                queue_tail.compare_exchange_strong(tail, next);
+            }
+        }
+    }
+};
+
+} // namespace lock_free
+
+#endif // SEGMENTED_LOCK_FREE_QUEUE_H
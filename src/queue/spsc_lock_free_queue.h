@@ -0,0 +1,134 @@
+#ifndef SPSC_LOCK_FREE_QUEUE_H
+#define SPSC_LOCK_FREE_QUEUE_H
+
+#include "abstract_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace lock_free {
+
+// wait-free очередь для одного производителя и одного потребителя
+// на кольцевом буфере. Каждая сторона пишет только свой индекс и
+// хранит копию чужого, чужой индекс перечитывается, только когда
+// по копии очередь кажется заполненной (пустой).
+// N - степень двойки
+template <typename T, size_t N = 128>
+class spsc_lock_free_queue:
+        public queue_base<spsc_lock_free_queue<T, N>, T>
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0,
+                  "spsc_lock_free_queue size must be a power of two");
+
+public:
+    spsc_lock_free_queue():
+        tail(0), cached_head(0), head(0), cached_tail(0) { }
+
+    // вызывается только потоком-производителем
+    bool enqueue(const T& value)
+    {
+        return put(value);
+    }
+
+    bool enqueue(T&& value)
+    {
+        return put(std::move(value));
+    }
+
+    // вызывается только потоком-потребителем
+    bool dequeue(T& result)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail)
+        {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail)
+                return false;
+        }
+
+        result = std::move(buffer[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // элементы копируются подряд, индекс публикуется один раз
+    size_t enqueue_bulk(const T* first, const T* last)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t n = last - first;
+        if (N - (t - cached_head) < n)
+        {
+            cached_head = head.load(std::memory_order_acquire);
+            if (N - (t - cached_head) < n)
+                n = N - (t - cached_head);
+        }
+
+        for (size_t i = 0; i < n; ++i)
+            buffer[(t + i) & mask] = first[i];
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t dequeue_bulk(T* out, size_t max)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (cached_tail - h < max)
+            cached_tail = tail.load(std::memory_order_acquire);
+
+        size_t n = cached_tail - h;
+        if (n > max)
+            n = max;
+
+        for (size_t i = 0; i < n; ++i)
+            out[i] = std::move(buffer[(h + i) & mask]);
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    // может вызываться любым потоком
+    size_t size() const
+    {
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_acquire);
+        return t - h;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+protected:
+    static const size_t mask = N - 1;
+
+    // данные производителя
+    alignas(128) std::atomic<size_t> tail;
+    size_t cached_head;
+
+    // данные потребителя
+    alignas(128) std::atomic<size_t> head;
+    size_t cached_tail;
+
+    alignas(128) T buffer[N];
+
+    template <typename V>
+    bool put(V&& value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head == N)
+        {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head == N)
+                return false;
+        }
+
+        buffer[t & mask] = std::forward<V>(value);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+} // namespace lock_free
+
+#endif // SPSC_LOCK_FREE_QUEUE_H
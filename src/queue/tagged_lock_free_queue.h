@@ -2,180 +2,222 @@
 #define TAGGED_LOCK_FREE_QUEUE_H
 
 #include "abstract_queue.h"
+#include "backoff.h"
+#include "striped_counter.h"
+#include "tagged_index.h"
+#include "tagged_node_pool.h"
 
-#include <array>
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <utility>
 
 namespace lock_free {
 
-template <typename T>
-struct node;
-
-// для решения ABA-проблемы
-// увеличиваем tag каждый раз при работе с указателем
-template <typename T>
-struct tagged_pointer
-{
-    node<T>* ptr;
-    uintptr_t tag;
-
-    tagged_pointer() noexcept: ptr(nullptr), tag(0) { }
-    tagged_pointer(node<T>* p) noexcept: ptr(p), tag(0) { }
-    tagged_pointer(node<T>* p, uintptr_t n) noexcept: ptr(p), tag(n) { }
-};
-
-template <typename T>
-struct node
-{
-    T data;
-    std::atomic<tagged_pointer<T>> next;
-};
-
-template <typename T>
-bool operator==(const tagged_pointer<T>& a, const tagged_pointer<T>& b)
-{
-    return a.ptr == b.ptr && a.tag == b.tag;
-}
-
-// lock-free очередь с использованием меченых указателей (tagged pointers)
-template <typename T, size_t N = 100>
-class tagged_lock_free_queue: public queue<T>
+// lock-free очередь с использованием меченых указателей (tagged pointers):
+// ссылки на узлы - 32-битные индексы в пуле узлов с 32-битным tag
+// (tagged_index), CAS всегда над одним 64-битным словом.
+// Пул растет по мере надобности, узлы в нем не освобождаются.
+// N - размер первого блока пула,
+// C - ожидание после неудачной CAS операции (no_backoff, exponential_backoff,
+// proportional_backoff)
+template <typename T, size_t N = 100, typename C = no_backoff>
+class tagged_lock_free_queue:
+        public queue_base<tagged_lock_free_queue<T, N, C>, T>
 {
 public:
     tagged_lock_free_queue()
     {
-        for (size_t i = 0; i < N - 1; ++i)
-            node_storage[i].next.store(tagged_pointer<T>(&node_storage[i+1]));
-
-        node_storage[N - 1].next.store(tagged_pointer<T>());
-        free_nodes.store(tagged_pointer<T>(&node_storage[0]));
-
         // queue_head и queue_tail указывают на dummy node
         // очередь пустая когда head == tail и tail->next == nullptr
-        node<T>* new_node = get_free_node();
-        new_node->next.store(tagged_pointer<T>());
-        queue_head.store(tagged_pointer<T>(new_node));
-        queue_tail.store(tagged_pointer<T>(new_node));
+        uint32_t dummy = nodes.get();
+        nodes.at(dummy)->set_free_next(0);
+        queue_head.store(tagged_index(dummy));
+        queue_tail.store(tagged_index(dummy));
     }
 
-    bool enqueue(const T& value) override
+    bool enqueue(const T& value)
     {
-        node<T>* new_node = get_free_node();
-        if (new_node == nullptr)
+        uint32_t i = nodes.get();
+        if (i == 0)
             return false;
-        new_node->data = value;
-        new_node->next.store(tagged_pointer<T>());
+        nodes.at(i)->data = value;
+        nodes.at(i)->set_free_next(0);
 
-        tagged_pointer<T> tail;
+        link_chain(i, i);
+        elements.increment();
+        return true;
+    }
 
-        while (true)
-        {
-            tail = queue_tail.load();
-            tagged_pointer<T> next = tail.ptr->next.load();
+    bool enqueue(T&& value)
+    {
+        uint32_t i = nodes.get();
+        if (i == 0)
+            return false;
+        nodes.at(i)->data = std::move(value);
+        nodes.at(i)->set_free_next(0);
 
-            if (tail == queue_tail.load())
-            {
-                // проверяем что tail указывает на последний элемент
-                if (next.ptr == nullptr)
-                {
-                    // пробуем добавить элемент в конец списка
-                    if (std::atomic_compare_exchange_strong(&tail.ptr->next,
-                             &next, tagged_pointer<T>(new_node, next.tag + 1)))
-                        break;
-                } else
-                {
-                    // queue_tail не указывает на последний элемент
-                    // пробуем переместить queue_tail
-                    std::atomic_compare_exchange_strong(&queue_tail, &tail,
-                         tagged_pointer<T>(next.ptr, tail.tag + 1));
-                }
-            }
+        link_chain(i, i);
+        elements.increment();
+        return true;
+    }
+
+    // цепочка из свободных узлов присоединяется к концу очереди
+    // одной CAS операцией, если индексы пула исчерпаны,
+    // добавляется только часть элементов
+    size_t enqueue_bulk(const T* first, const T* last)
+    {
+        uint32_t chain_first = 0;
+        uint32_t chain_last = 0;
+        size_t count = 0;
+        for (; first != last; ++first, ++count)
+        {
+            uint32_t i = nodes.get();
+            if (i == 0)
+                break;
+            nodes.at(i)->data = *first;
+            nodes.at(i)->set_free_next(0);
+            if (chain_last != 0)
+                nodes.at(chain_last)->set_free_next(i);
+            else
+                chain_first = i;
+            chain_last = i;
         }
 
-        // пробуем переместить queue_tail на вставленный элемент
-        std::atomic_compare_exchange_strong(&queue_tail,
-             &tail,tagged_pointer<T>(new_node, tail.tag + 1));
-        return true;
+        if (chain_first != 0)
+            link_chain(chain_first, chain_last);
+        elements.add(count);
+        return count;
     }
 
-    bool dequeue(T& result) override
+    bool dequeue(T& result)
     {
-        tagged_pointer<T> head;
+        C backoff;
+        tagged_index head;
 
         while (true)
         {
             head = queue_head.load();
-            tagged_pointer<T> tail = queue_tail.load();
-            tagged_pointer<T> next = head.ptr->next.load();
+            tagged_index tail = queue_tail.load();
+            tagged_index next = nodes.at(head.index)->next.load();
 
             if (head == queue_head.load())
             {
                 // проверяем что очередь пуста или tail не последний
-                if (head.ptr == tail.ptr)
+                if (head.index == tail.index)
                 {
                     // проверяем что очередь пуста
-                    if (next.ptr == nullptr)
+                    if (next.index == 0)
                         return false; // // очередь пуста
 
                     // queue_tail не указывает на последний элемент
                     // пробуем переместить queue_tail
-                    std::atomic_compare_exchange_strong(&queue_tail, &tail,
-                         tagged_pointer<T>(next.ptr, tail.tag + 1));
+                    queue_tail.compare_exchange_strong(tail,
+                         tagged_index(next.index, tail.tag + 1));
                 } else
                 {
-                    // очередь не пуста
-                    result = next.ptr->data;
+                    // очередь не пуста.
+                    // Данные копируются до CAS: после перемещения
+                    // queue_head узел может вернуться в пул
+                    // и быть перезаписан, перемещать их нельзя
+                    result = nodes.at(next.index)->data;
                     // пробуем передвинуть queue_head
-                    if (std::atomic_compare_exchange_strong(&queue_head, &head,
-                         tagged_pointer<T>(next.ptr, head.tag + 1)))
+                    if (queue_head.compare_exchange_strong(head,
+                         tagged_index(next.index, head.tag + 1)))
                         break;
                 }
             }
+            backoff();
         }
 
-        // добавляем dummy node в список свободных элементов
-        add_to_free_nodes(head.ptr);
+        // возвращаем dummy node в пул
+        nodes.put(head.index);
+        elements.decrement();
         return true;
     }
 
-protected:
-    alignas(128) std::atomic<tagged_pointer<T>> queue_head;
-    alignas(128) std::atomic<tagged_pointer<T>> queue_tail;
+    // число элементов по счетчику (см. striped_counter)
+    size_t size() const
+    {
+        return elements.size();
+    }
 
-    // free_nodes указывает на свободные элементы в node_storage
-    alignas(128) std::atomic<tagged_pointer<T>> free_nodes;
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
 
-    // список свободных элементов
-    // вместо удаления помещаем элемент в node_storage
-    std::array<node<T>, N> node_storage;
+    // узлы не освобождаются, читать next можно без защиты
+    bool empty() const
+    {
+        tagged_index head = queue_head.load();
+        return nodes.at(head.index)->next.load().index == 0;
+    }
 
-    node<T>* get_free_node()
+protected:
+    struct node
     {
-        tagged_pointer<T> next;
-        tagged_pointer<T> curr = free_nodes.load();
+        T data;
+        std::atomic<tagged_index> next;
 
-        do
+        uint32_t free_next() const
         {
-            if (curr.ptr == nullptr)
-                return nullptr;
-            next.tag = curr.tag + 1;
-            next.ptr = curr.ptr->next.load().ptr;
-        } while (!free_nodes.compare_exchange_weak(curr, next));
-        return curr.ptr;
-    }
+            return next.load().index;
+        }
+
+        // tag в next не сбрасывается и при повторном использовании узла:
+        // по нему CAS в link_chain отличает новый конец очереди
+        // от старого с тем же индексом
+        void set_free_next(uint32_t i)
+        {
+            next.store(tagged_index(i, next.load().tag + 1));
+        }
+    };
+
+    alignas(128) std::atomic<tagged_index> queue_head;
+    alignas(128) std::atomic<tagged_index> queue_tail;
+
+    // вместо удаления узлы возвращаются в пул
+    tagged_node_pool<node, N, 16, C> nodes;
+    striped_counter<> elements;
 
-    void add_to_free_nodes(node<T>* node)
+    // добавление цепочки first..last в конец очереди
+    void link_chain(uint32_t first, uint32_t last)
     {
-        tagged_pointer<T> new_top;
-        tagged_pointer<T> curr = free_nodes.load();
+        C backoff;
+        tagged_index tail;
 
-        do
+        while (true)
         {
-            node->next = curr.ptr;
-            new_top.tag = curr.tag + 1;
-            new_top.ptr = node;
-        } while (!free_nodes.compare_exchange_weak(curr, new_top));
+            tail = queue_tail.load();
+            tagged_index next = nodes.at(tail.index)->next.load();
+
+            if (tail == queue_tail.load())
+            {
+                // проверяем что tail указывает на последний элемент
+                if (next.index == 0)
+                {
+                    // пробуем добавить цепочку в конец списка
+                    if (nodes.at(tail.index)->next.compare_exchange_strong(
+                             next, tagged_index(first, next.tag + 1)))
+                        break;
+                } else
+                {
+                    // queue_tail не указывает на последний элемент
+                    // пробуем переместить queue_tail
+                    queue_tail.compare_exchange_strong(tail,
+                         tagged_index(next.index, tail.tag + 1));
+                }
+            }
+            backoff();
+        }
+
+        // пробуем переместить queue_tail на последний вставленный элемент
+        queue_tail.compare_exchange_strong(tail,
+             tagged_index(last, tail.tag + 1));
     }
 };
 
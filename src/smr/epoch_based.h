@@ -0,0 +1,303 @@
+#ifndef EPOCH_BASED_H
+#define EPOCH_BASED_H
+
+// based on Fraser's "Practical lock-freedom", ch. 5 (epoch-based reclamation)
+
+#include "reclaimable.h"
+#include "smr_stats.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace lock_free {
+
+// количество отложенных элементов, после которого поток
+// пробует продвинуть глобальную эпоху и освободить старые элементы
+const unsigned int epoch_reclaim_threshold = 64;
+
+// глобальная эпоха, увеличивается когда все активные потоки ее увидели
+std::atomic<uint64_t> global_epoch(0);
+
+// запись потока: объявленная эпоха и отложенные элементы.
+// Записи не удаляются и переиспользуются после завершения потока
+struct epoch_record
+{
+    // (эпоха << 1) | признак активности
+    alignas(128) std::atomic<uint64_t> state;
+    std::atomic<bool> in_use;
+    epoch_record* next;
+
+    // поля ниже использует только владелец записи
+    unsigned int nesting;
+    unsigned int retired_since_scan;
+    // элементы, отложенные в эпоху limbo_epoch[i],
+    // связаны через сами узлы (reclaimable::next_retired)
+    reclaimable* limbo[3];
+    uint64_t limbo_epoch[3];
+
+    epoch_record():
+        state(0), in_use(true), next(nullptr),
+        nesting(0), retired_since_scan(0),
+        limbo{nullptr, nullptr, nullptr}, limbo_epoch{0, 0, 0} { }
+};
+
+// список записей всех потоков, только добавление
+std::atomic<epoch_record*> epoch_records(nullptr);
+
+// отложенные элементы завершившихся потоков: цепочка и эпоха,
+// не позже которой они отложены. Цепочки забирают себе живые
+// и завершающиеся потоки при очередном освобождении
+struct epoch_orphan
+{
+    reclaimable* head;
+    uint64_t epoch;
+    epoch_orphan* next;
+};
+
+std::atomic<epoch_orphan*> epoch_orphans(nullptr);
+
+bool epoch_try_advance(uint64_t epoch);
+void epoch_collect(epoch_record* r);
+void epoch_orphan_limbo(epoch_record* r);
+
+class epoch_owner
+{
+public:
+    epoch_owner(const epoch_owner&) = delete;
+    epoch_owner operator=(const epoch_owner&) = delete;
+
+    epoch_owner(): record(nullptr)
+    {
+        // пробуем занять освободившуюся запись
+        for (epoch_record* r = epoch_records.load(); r; r = r->next)
+        {
+            bool expected = false;
+            if (r->in_use.compare_exchange_strong(expected, true))
+            {
+                record = r;
+                return;
+            }
+        }
+
+        record = new epoch_record();
+        epoch_record* head = epoch_records.load();
+        do
+        {
+            record->next = head;
+        } while (!epoch_records.compare_exchange_weak(head, record));
+    }
+
+    // при завершении потока освобождаем что можно, остальное
+    // передаем в список сирот: запись может не найти нового владельца
+    ~epoch_owner()
+    {
+        epoch_try_advance(global_epoch.load());
+        epoch_collect(record);
+        epoch_orphan_limbo(record);
+        record->state.store(0);
+        record->in_use.store(false);
+    }
+
+    epoch_record* get()
+    {
+        return record;
+    }
+
+protected:
+    epoch_record* record;
+};
+
+epoch_record* get_epoch_record_for_current_thread()
+{
+    thread_local static epoch_owner owner;
+    return owner.get();
+}
+
+// вход в критическую секцию: одна запись эпохи и один барьер на операцию
+void epoch_enter(epoch_record* r)
+{
+    if (r->nesting++ == 0)
+    {
+        r->state.store((global_epoch.load() << 1) | 1,
+                       std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void epoch_exit(epoch_record* r)
+{
+    if (--r->nesting == 0)
+        r->state.store(0, std::memory_order_release);
+}
+
+// эпоху можно увеличить, если все активные потоки объявили текущую
+bool epoch_try_advance(uint64_t epoch)
+{
+    for (epoch_record* r = epoch_records.load(); r; r = r->next)
+    {
+        uint64_t s = r->state.load();
+        if ((s & 1) && (s >> 1) != epoch)
+            return false;
+    }
+
+    return global_epoch.compare_exchange_strong(epoch, epoch + 1);
+}
+
+void epoch_free(reclaimable*& list)
+{
+    while (list != nullptr)
+    {
+        reclaimable* next = list->next_retired;
+        smr_stats_on_reclaim(list->deleter(list));
+        list = next;
+    }
+}
+
+// цепочка list, отложенная не позже эпохи e, переходит в запись r
+void epoch_adopt(epoch_record* r, reclaimable* list, uint64_t e,
+                 uint64_t epoch)
+{
+    if (e + 2 <= epoch)
+    {
+        epoch_free(list);
+        return;
+    }
+
+    // эпоха уже не больше e + 1, поэтому в ячейке элементы
+    // эпохи e или не позже e - 3
+    size_t i = e % 3;
+    if (r->limbo_epoch[i] != e)
+    {
+        epoch_free(r->limbo[i]);
+        r->limbo_epoch[i] = e;
+    }
+
+    reclaimable* last = list;
+    while (last->next_retired != nullptr)
+        last = last->next_retired;
+    last->next_retired = r->limbo[i];
+    r->limbo[i] = list;
+}
+
+// элементы, отложенные в эпоху e, не видны потокам начиная с эпохи e + 2
+void epoch_collect(epoch_record* r)
+{
+    uint64_t epoch = global_epoch.load();
+
+    if (epoch_orphans.load(std::memory_order_relaxed) != nullptr)
+    {
+        epoch_orphan* o = epoch_orphans.exchange(nullptr);
+        while (o != nullptr)
+        {
+            epoch_orphan* next = o->next;
+            epoch_adopt(r, o->head, o->epoch, epoch);
+            delete o;
+            o = next;
+        }
+    }
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        if (r->limbo_epoch[i] + 2 <= epoch)
+            epoch_free(r->limbo[i]);
+    }
+}
+
+// непустые цепочки записи - в список сирот
+void epoch_orphan_limbo(epoch_record* r)
+{
+    for (size_t i = 0; i < 3; ++i)
+    {
+        if (r->limbo[i] == nullptr)
+            continue;
+
+        epoch_orphan* o = new epoch_orphan{r->limbo[i], r->limbo_epoch[i],
+                                           nullptr};
+        r->limbo[i] = nullptr;
+
+        epoch_orphan* head = epoch_orphans.load();
+        do
+        {
+            o->next = head;
+        } while (!epoch_orphans.compare_exchange_weak(head, o));
+    }
+    r->retired_since_scan = 0;
+}
+
+template <typename T>
+void epoch_retire(T* p)
+{
+    epoch_record* r = get_epoch_record_for_current_thread();
+
+    uint64_t epoch = global_epoch.load();
+    size_t i = epoch % 3;
+    if (r->limbo_epoch[i] != epoch)
+    {
+        // в ячейке элементы эпохи не позже epoch - 3
+        epoch_free(r->limbo[i]);
+        r->limbo_epoch[i] = epoch;
+    }
+
+    reclaimable* retired = make_reclaimable(p);
+    retired->next_retired = r->limbo[i];
+    r->limbo[i] = retired;
+    smr_stats_on_retire(sizeof(T));
+
+    if (++r->retired_since_scan >= epoch_reclaim_threshold)
+    {
+        r->retired_since_scan = 0;
+        epoch_try_advance(epoch);
+        epoch_collect(r);
+    }
+}
+
+// политика освобождения памяти для контейнеров: эпохи.
+// Указатели не объявляются по отдельности, поток объявляет
+// эпоху один раз на операцию
+struct epoch_reclamation
+{
+    // guard защищает все узлы, прочитанные за время его жизни
+    static const bool guards_region = true;
+
+    class guard
+    {
+    public:
+        guard(): record(get_epoch_record_for_current_thread())
+        {
+            epoch_enter(record);
+        }
+
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+
+        ~guard()
+        {
+            epoch_exit(record);
+        }
+
+        void protect(size_t, void*) { }
+
+        template <typename P>
+        P protect(size_t, const std::atomic<P>& src)
+        {
+            return src.load();
+        }
+
+        void clear(size_t) { }
+
+        void protect_group(size_t, void*) { }
+
+    protected:
+        epoch_record* record;
+    };
+
+    template <typename T>
+    static void retire(T* p)
+    {
+        epoch_retire(p);
+    }
+};
+
+} // namespace lock_free
+
+#endif // EPOCH_BASED_H
@@ -3,28 +3,53 @@
 
 // based on Williams' C++ concurrency in action, ch. 7
 
+#include "reclaimable.h"
+#include "smr_stats.h"
+
 #include <algorithm>
 #include <atomic>
 #include <functional>
-#include <thread>
 #include <vector>
 
 namespace lock_free {
 
-// максимальное количество hazard указателей
-const unsigned int max_hazard_pointers   = 100;
 // количество hazard указателей доступных каждому потоку
 const unsigned int max_hp_per_thread     = 5;
-// максимальный размер массива отложенных для удаления элементов
-const unsigned int max_reclaim_list_size = 100;
+// блок hazard указателей потока для групповых операций
+// (одновременный обход нескольких списков, по два указателя на список)
+const unsigned int max_group_hp          = 32;
+// порог просмотра списка отложенных элементов: R = k * H,
+// где H - число hazard указателей активных потоков (Michael, 2004).
+// После просмотра в списке остается не больше H элементов, значит
+// каждый просмотр освобождает не меньше (k - 1) * H элементов
+const unsigned int reclaim_scan_factor   = 2;
+// нижняя граница порога при малом числе потоков
+const unsigned int min_reclaim_list_size = 64;
 
-struct hazard_pointer
+// hazard указатели одного потока, каждая запись в своей кэш-линии.
+// Записи не удаляются: после завершения потока запись
+// освобождается и достается следующему потоку
+struct alignas(128) hp_record
 {
-    std::atomic<std::thread::id> id;
-    std::atomic<void*> pointer;
+    std::atomic<void*> pointers[max_hp_per_thread];
+    std::atomic<bool> active;
+    hp_record* next;
+    // групповые указатели, в своих кэш-линиях
+    alignas(128) std::atomic<void*> group[max_group_hp];
+
+    hp_record(): active(true), next(nullptr)
+    {
+        for (size_t i = 0; i < max_hp_per_thread; ++i)
+            pointers[i].store(nullptr);
+        for (size_t i = 0; i < max_group_hp; ++i)
+            group[i].store(nullptr);
+    }
 };
 
-std::vector<hazard_pointer> hazard_pointers(max_hazard_pointers);
+// список записей всех потоков, растет по мере появления потоков
+std::atomic<hp_record*> hp_records(nullptr);
+// число занятых записей, определяет порог просмотра
+std::atomic<size_t> hp_active_records(0);
 
 class hp_owner
 {
@@ -34,133 +59,326 @@ public:
 
     hp_owner(): hp(nullptr)
     {
-        for (size_t i = 0; i < max_hazard_pointers; ++i)
+        // попытка завладеть свободной записью
+        for (hp_record* r = hp_records.load(); r; r = r->next)
         {
-            std::thread::id old_id;
-
-            // попытка завладеть hazard указателем
-            if (hazard_pointers[i].id.compare_exchange_strong(
-                        old_id, std::this_thread::get_id()))
+            bool expected = false;
+            if (!r->active.load() &&
+                    r->active.compare_exchange_strong(expected, true))
             {
-                hp = &hazard_pointers[i];
-                break;
+                hp = r;
+                hp_active_records.fetch_add(1);
+                return;
             }
         }
 
-        if (!hp)
-            throw std::runtime_error("no hazard pointers available");
+        // свободных нет, добавляем новую запись в начало списка
+        hp_active_records.fetch_add(1);
+        hp = new hp_record();
+        hp_record* head = hp_records.load();
+        do
+        {
+            hp->next = head;
+        } while (!hp_records.compare_exchange_weak(head, hp));
     }
 
-    std::atomic<void*>& get_pointer()
+    std::atomic<void*>& get_pointer(size_t i)
     {
-        return hp->pointer;
+        return hp->pointers[i];
+    }
+
+    std::atomic<void*>& get_group_pointer(size_t i)
+    {
+        return hp->group[i];
     }
 
     ~hp_owner()
     {
-            hp->pointer.store(nullptr);
-            hp->id.store(std::thread::id());
+        for (size_t i = 0; i < max_hp_per_thread; ++i)
+            hp->pointers[i].store(nullptr);
+        for (size_t i = 0; i < max_group_hp; ++i)
+            hp->group[i].store(nullptr);
+        hp->active.store(false);
+        hp_active_records.fetch_sub(1);
     }
 
 protected:
-    hazard_pointer *hp;
+    hp_record* hp;
 };
 
-std::atomic<void*>& get_hazard_pointer_for_current_thread(size_t i)
+hp_owner& get_hp_owner_for_current_thread()
 {
     // у каждого потока свои hazard указатели
-    thread_local static hp_owner hp[max_hp_per_thread];
-    return hp[i].get_pointer();
+    thread_local static hp_owner hp;
+    return hp;
 }
 
-// проверка указателя на присутствие в массиве hazard указателей
+std::atomic<void*>& get_hazard_pointer_for_current_thread(size_t i)
+{
+    return get_hp_owner_for_current_thread().get_pointer(i);
+}
+
+std::atomic<void*>& get_group_hazard_pointer_for_current_thread(size_t i)
+{
+    return get_hp_owner_for_current_thread().get_group_pointer(i);
+}
+
+// проверка указателя на присутствие среди hazard указателей
 bool hazard(void* p)
 {
-    for (size_t i = 0; i < max_hazard_pointers; ++i)
+    for (hp_record* r = hp_records.load(); r; r = r->next)
     {
-        if (hazard_pointers[i].pointer.load() == p)
-            return true;
+        if (!r->active.load())
+            continue;
+
+        for (size_t i = 0; i < max_hp_per_thread; ++i)
+        {
+            if (r->pointers[i].load() == p)
+                return true;
+        }
+        for (size_t i = 0; i < max_group_hp; ++i)
+        {
+            if (r->group[i].load() == p)
+                return true;
+        }
     }
 
     return false;
 }
 
-struct data_to_reclaim;
-
-// уникальный для каждого потока массив отложенных для удаления элементов
-thread_local static std::vector<data_to_reclaim*> reclaim_list;
+// отложенные элементы завершившихся потоков, их забирают
+// себе живые потоки при очередном просмотре
+std::atomic<reclaimable*> hp_orphans(nullptr);
 
-template <typename T>
-void do_delete(void* p)
+// добавление цепочки first..last в список сирот
+void push_orphans(reclaimable* first, reclaimable* last)
 {
-    delete static_cast<T*>(p);
+    reclaimable* head = hp_orphans.load();
+    do
+    {
+        last->next_retired = head;
+    } while (!hp_orphans.compare_exchange_weak(head, first));
 }
 
-// структура, сохраняющая информацию о типе объекта
-// для последующего корректного удаления
-struct data_to_reclaim
+struct reclaim_list_type;
+void delete_nodes_with_no_hazards(reclaim_list_type& list);
+
+// уникальный для каждого потока список отложенных для удаления элементов,
+// связанный через сами узлы (reclaimable::next_retired)
+struct reclaim_list_type
 {
-    void* data;
-    std::function<void(void*)> deleter;
+    reclaimable* head;
+    size_t size;
+    // буфер для hazard указателей при просмотре,
+    // переиспользуется, чтобы просмотр не выделял память
+    std::vector<void*> hazards;
 
-    template <typename T>
-    data_to_reclaim(T* p):
-        data(p),
-        deleter(&do_delete<T>) { }
+    reclaim_list_type(): head(nullptr), size(0) { }
 
-    ~data_to_reclaim()
+    // при завершении потока освобождаем что можно,
+    // остальное передаем в список сирот
+    ~reclaim_list_type()
     {
-        deleter(data);
+        if (head == nullptr)
+            return;
+
+        delete_nodes_with_no_hazards(*this);
+        if (head == nullptr)
+            return;
+
+        reclaimable* last = head;
+        while (last->next_retired != nullptr)
+            last = last->next_retired;
+        push_orphans(head, last);
+
+        head = nullptr;
+        size = 0;
     }
 };
 
+thread_local static reclaim_list_type reclaim_list;
+
+// текущий порог просмотра: R = k * H
+size_t reclaim_threshold()
+{
+    size_t r = reclaim_scan_factor * (max_hp_per_thread + max_group_hp) *
+            hp_active_records.load(std::memory_order_relaxed);
+    return r < min_reclaim_list_size ? min_reclaim_list_size : r;
+}
+
 // освобождение безопасных указателей
-void delete_nodes_with_no_hazards()
+void delete_nodes_with_no_hazards(reclaim_list_type& list)
 {
-    std::vector<void*> hp;
+    // сначала забираем весь просматриваемый список, в том числе
+    // элементы завершившихся потоков: hazard указатели должны читаться
+    // после retire каждого просматриваемого элемента, иначе указатель,
+    // объявленный до удаления узла из структуры, может быть пропущен
+    reclaimable* curr = list.head;
+    list.head = nullptr;
+    list.size = 0;
+
+    reclaimable* orphans = nullptr;
+    if (hp_orphans.load(std::memory_order_relaxed) != nullptr)
+        orphans = hp_orphans.exchange(nullptr);
 
-    // добавляем все ненулевые hazard указатели в массив hp
-    for (size_t i = 0; i < max_hazard_pointers; ++i)
+    if (curr == nullptr)
     {
-        void* p = hazard_pointers[i].pointer.load();
-        if (p)
-            hp.push_back(p);
+        curr = orphans;
     }
+    else if (orphans != nullptr)
+    {
+        reclaimable* last = curr;
+        while (last->next_retired != nullptr)
+            last = last->next_retired;
+        last->next_retired = orphans;
+    }
+
+    std::vector<void*>& hp = list.hazards;
+    hp.clear();
+
+    // добавляем все ненулевые hazard указатели в массив hp,
+    // записи завершившихся потоков пропускаем
+    for (hp_record* r = hp_records.load(); r; r = r->next)
+    {
+        if (!r->active.load())
+            continue;
 
-    // сортируем для удобного поиска
+        for (size_t i = 0; i < max_hp_per_thread; ++i)
+        {
+            void* p = r->pointers[i].load();
+            if (p)
+                hp.push_back(p);
+        }
+        for (size_t i = 0; i < max_group_hp; ++i)
+        {
+            void* p = r->group[i].load();
+            if (p)
+                hp.push_back(p);
+        }
+    }
+
+    // сортируем для удобного поиска,
+    // одна сортировка на порог отложенных элементов
     sort(hp.begin(), hp.end(), std::less<void*>());
 
-    auto i = reclaim_list.begin();
-    while (i != reclaim_list.end())
+    while (curr != nullptr)
     {
-        // если указатель не в списке опасных, удаляем
-        if (!std::binary_search(hp.begin(), hp.end(), (*i)->data))
+        reclaimable* next = curr->next_retired;
+
+        // если указатель не в списке опасных, удаляем,
+        // иначе возвращаем в список
+        if (!std::binary_search(hp.begin(), hp.end(),
+                                static_cast<void*>(curr)))
         {
-            delete *i;
-            if (&*i != &reclaim_list.back())
-                *i = reclaim_list.back();
-            reclaim_list.pop_back();
+            smr_stats_on_reclaim(curr->deleter(curr));
         }
-        else ++i;
+        else
+        {
+            curr->next_retired = list.head;
+            list.head = curr;
+            ++list.size;
+        }
+
+        curr = next;
     }
 }
 
-void add_to_reclaim_list(data_to_reclaim* data)
+void add_to_reclaim_list(reclaimable* data)
 {
-    reclaim_list.push_back(data);
+    data->next_retired = reclaim_list.head;
+    reclaim_list.head = data;
 
-    // при достижении макс. размера
+    // при достижении порога
     // пробуем удалить элементы, не отмеченные как hazard
-    if (reclaim_list.size() == max_reclaim_list_size)
-        delete_nodes_with_no_hazards();
+    if (++reclaim_list.size >= reclaim_threshold())
+        delete_nodes_with_no_hazards(reclaim_list);
 }
 
 template <typename T>
 void reclaim_later(T* data)
 {
-    add_to_reclaim_list(new data_to_reclaim(data));
+    smr_stats_on_retire(sizeof(T));
+    add_to_reclaim_list(make_reclaimable(data));
 }
 
+// политика освобождения памяти для контейнеров: hazard указатели.
+// guard на время операции, protect объявляет указатель опасным,
+// retire откладывает удаление до исчезновения опасных ссылок
+struct hazard_reclamation
+{
+    // guard защищает только объявленные указатели
+    static const bool guards_region = false;
+
+    class guard
+    {
+    public:
+        guard(): used(0), group_used(0) { }
+
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+
+        ~guard()
+        {
+            for (size_t i = 0; used != 0; ++i, used >>= 1)
+            {
+                if (used & 1)
+                    get_hazard_pointer_for_current_thread(i).store(nullptr);
+            }
+            for (size_t i = 0; i < group_used; ++i)
+                get_group_hazard_pointer_for_current_thread(i).store(nullptr);
+        }
+
+        // групповой указатель i < max_group_hp: для операций,
+        // которым нужно больше max_hp_per_thread указателей сразу.
+        // В потоке групповые указатели использует один guard
+        void protect_group(size_t i, void* p)
+        {
+            if (i >= group_used)
+                group_used = i + 1;
+            get_group_hazard_pointer_for_current_thread(i).store(p);
+        }
+
+        void protect(size_t i, void* p)
+        {
+            used |= 1u << i;
+            get_hazard_pointer_for_current_thread(i).store(p);
+        }
+
+        // загрузка указателя из src с объявлением его опасным
+        template <typename P>
+        P protect(size_t i, const std::atomic<P>& src)
+        {
+            P p = src.load();
+            P temp;
+            do
+            {
+                temp = p;
+                protect(i, p);
+                p = src.load();
+            } while (p != temp);
+            return p;
+        }
+
+        void clear(size_t i)
+        {
+            used &= ~(1u << i);
+            get_hazard_pointer_for_current_thread(i).store(nullptr);
+        }
+
+    protected:
+        // занятые операцией hazard указатели
+        unsigned int used;
+        // число занятых групповых указателей (от начала блока)
+        size_t group_used;
+    };
+
+    template <typename T>
+    static void retire(T* p)
+    {
+        reclaim_later(p);
+    }
+};
+
 } // namespace lock_free
 
 #endif // HAZARD_POINTER_H
@@ -0,0 +1,43 @@
+#ifndef RECLAIMABLE_H
+#define RECLAIMABLE_H
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+namespace lock_free {
+
+// базовый класс узлов контейнеров: ссылка в списке отложенных
+// для удаления элементов и функция удаления хранятся в самом узле,
+// поэтому отложенное удаление не выделяет память.
+// Должен быть единственным базовым классом узла (адрес узла
+// совпадает с адресом reclaimable, его сравнивают с hazard указателями)
+struct reclaimable
+{
+    reclaimable* next_retired;
+    // удаляет узел, возвращает его размер
+    size_t (*deleter)(reclaimable*);
+};
+
+template <typename T>
+size_t delete_reclaimable(reclaimable* p)
+{
+    delete static_cast<T*>(p);
+    return sizeof(T);
+}
+
+template <typename T>
+reclaimable* make_reclaimable(T* p)
+{
+    static_assert(std::is_base_of<reclaimable, T>::value,
+                  "retired nodes must derive from lock_free::reclaimable");
+
+    reclaimable* r = p;
+    assert(static_cast<void*>(r) == static_cast<void*>(p));
+    r->deleter = &delete_reclaimable<T>;
+    return r;
+}
+
+} // namespace lock_free
+
+#endif // RECLAIMABLE_H
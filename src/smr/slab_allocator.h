@@ -0,0 +1,354 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+// пул узлов по классам размеров: у каждого потока своя куча (slab_heap)
+// со списками свободных блоков, блоки выделяются из слэбов (slab)
+// этого потока. Блок, освобожденный чужим потоком (например, при
+// отложенном удалении в SMR), кладется в удаленный список (remote)
+// кучи-владельца одной CAS операцией, владелец забирает весь список
+// одной операцией exchange - ABA-проблемы нет.
+// Слэбы нарезаются из арен и не возвращаются системе.
+// Макрос LOCK_FREE_HUGE_PAGES - арены выделяются через mmap
+// с просьбой к ядру использовать huge pages (Linux)
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#ifdef LOCK_FREE_HUGE_PAGES
+#include <sys/mman.h>
+#endif
+
+namespace lock_free {
+
+// шаг классов размеров и наибольший размер блока из пула,
+// большие объекты выделяются обычным operator new
+const size_t slab_granularity = 16;
+const size_t slab_max_block   = 1024;
+const size_t slab_classes     = slab_max_block / slab_granularity;
+// слэб выровнен по своему размеру, заголовок слэба
+// находится по адресу блока с обнуленными младшими битами
+const size_t slab_size        = 64 * 1024;
+const size_t slab_arena_size  = 2 * 1024 * 1024;
+
+struct slab_heap;
+
+struct slab_block
+{
+    slab_block* next;
+};
+
+// заголовок в начале слэба
+struct slab_header
+{
+    slab_heap* owner;
+};
+
+// свободные блоки одного класса размеров в куче потока
+struct slab_class
+{
+    // только для потока-владельца
+    slab_block* local;
+    char* bump;
+    char* bump_end;
+    // блоки, освобожденные другими потоками
+    std::atomic<slab_block*> remote;
+};
+
+// куча потока, каждая в своих кэш-линиях.
+// Кучи не удаляются: после завершения потока куча освобождается
+// вместе со своими блоками и достается следующему потоку
+struct alignas(128) slab_heap
+{
+    slab_class classes[slab_classes];
+    std::atomic<bool> active;
+    slab_heap* next;
+
+    slab_heap(): active(true), next(nullptr)
+    {
+        for (size_t i = 0; i < slab_classes; ++i)
+        {
+            classes[i].local = nullptr;
+            classes[i].bump = nullptr;
+            classes[i].bump_end = nullptr;
+            classes[i].remote.store(nullptr);
+        }
+    }
+};
+
+// арена, из которой нарезаются слэбы всех потоков
+struct slab_arena
+{
+    char* base;
+    std::atomic<size_t> used;
+    slab_arena* next;
+};
+
+std::atomic<slab_heap*> slab_heaps(nullptr);
+std::atomic<slab_arena*> slab_arenas(nullptr);
+// число выделенных арен, для статистики
+std::atomic<size_t> slab_arena_count(0);
+
+// память арены выровнена по размеру слэба
+inline char* allocate_arena_memory(void*& mapping)
+{
+#ifdef LOCK_FREE_HUGE_PAGES
+    // запас на выравнивание по размеру арены
+    void* p = mmap(nullptr, 2 * slab_arena_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        throw std::bad_alloc();
+    mapping = p;
+    uintptr_t a = (reinterpret_cast<uintptr_t>(p) + slab_arena_size - 1) &
+            ~(static_cast<uintptr_t>(slab_arena_size) - 1);
+#ifdef MADV_HUGEPAGE
+    madvise(reinterpret_cast<void*>(a), slab_arena_size, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<char*>(a);
+#else
+    mapping = ::operator new(slab_arena_size, std::align_val_t(slab_size));
+    return static_cast<char*>(mapping);
+#endif
+}
+
+inline void free_arena_memory(void* mapping)
+{
+#ifdef LOCK_FREE_HUGE_PAGES
+    munmap(mapping, 2 * slab_arena_size);
+#else
+    ::operator delete(mapping, std::align_val_t(slab_size));
+#endif
+}
+
+// новый слэб из текущей арены, при ее исчерпании добавляется новая
+inline char* allocate_slab()
+{
+    while (true)
+    {
+        slab_arena* a = slab_arenas.load();
+        if (a != nullptr)
+        {
+            size_t offset = a->used.fetch_add(slab_size);
+            if (offset + slab_size <= slab_arena_size)
+                return a->base + offset;
+        }
+
+        // первый слэб новой арены сразу наш
+        void* mapping;
+        slab_arena* n = new slab_arena;
+        n->base = allocate_arena_memory(mapping);
+        n->used.store(slab_size);
+        n->next = a;
+        if (slab_arenas.compare_exchange_strong(a, n))
+        {
+            slab_arena_count.fetch_add(1);
+            return n->base;
+        }
+
+        // арену уже добавил другой поток
+        free_arena_memory(mapping);
+        delete n;
+    }
+}
+
+// куча текущего потока. Блоки, освобождаемые после завершения потока
+// (деструкторы других thread_local объектов), уходят в удаленный список
+// кучи, из которой они выделены
+class slab_heap_owner
+{
+public:
+    slab_heap_owner(const slab_heap_owner&) = delete;
+    slab_heap_owner operator=(const slab_heap_owner&) = delete;
+
+    slab_heap_owner(): heap(nullptr) { }
+
+    slab_heap* get()
+    {
+        if (heap == nullptr)
+            heap = acquire();
+        return heap;
+    }
+
+    slab_heap* current() const
+    {
+        return heap;
+    }
+
+    ~slab_heap_owner()
+    {
+        if (heap != nullptr)
+            heap->active.store(false);
+        heap = nullptr;
+    }
+
+protected:
+    slab_heap* heap;
+
+    static slab_heap* acquire()
+    {
+        // попытка завладеть кучей завершившегося потока
+        for (slab_heap* h = slab_heaps.load(); h; h = h->next)
+        {
+            bool expected = false;
+            if (!h->active.load() &&
+                    h->active.compare_exchange_strong(expected, true))
+                return h;
+        }
+
+        // свободных нет, добавляем новую кучу в начало списка
+        slab_heap* h = new slab_heap();
+        slab_heap* head = slab_heaps.load();
+        do
+        {
+            h->next = head;
+        } while (!slab_heaps.compare_exchange_weak(head, h));
+        return h;
+    }
+};
+
+thread_local static slab_heap_owner slab_owner;
+
+inline size_t slab_class_index(size_t size)
+{
+    return (size + slab_granularity - 1) / slab_granularity - 1;
+}
+
+// блоки класса начинаются с адреса, выровненного по младшему биту
+// размера блока, поэтому каждый блок выровнен по этому биту.
+// Размер с выравниванием align > 16 округляется до кратного align:
+// младший бит такого размера не меньше align
+inline size_t slab_aligned_size(size_t size, size_t align)
+{
+    if (size == 0)
+        size = 1;
+    if (align > slab_granularity)
+        size = (size + align - 1) & ~(align - 1);
+    return size;
+}
+
+// большие объекты и выравнивание больше, чем у operator new по умолчанию
+inline void* slab_new(size_t size, size_t align)
+{
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return ::operator new(size, std::align_val_t(align));
+    return ::operator new(size);
+}
+
+inline void slab_delete(void* p, size_t align)
+{
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        ::operator delete(p, std::align_val_t(align));
+    else
+        ::operator delete(p);
+}
+
+// align - степень двойки, как alignof
+inline void* slab_allocate(size_t size, size_t align = slab_granularity)
+{
+    size = slab_aligned_size(size, align);
+    if (size > slab_max_block)
+        return slab_new(size, align);
+
+    slab_heap* heap = slab_owner.get();
+    slab_class& c = heap->classes[slab_class_index(size)];
+
+    if (c.local == nullptr &&
+            c.remote.load(std::memory_order_relaxed) != nullptr)
+        c.local = c.remote.exchange(nullptr, std::memory_order_acquire);
+
+    if (c.local != nullptr)
+    {
+        slab_block* b = c.local;
+        c.local = b->next;
+        return b;
+    }
+
+    size_t block = (slab_class_index(size) + 1) * slab_granularity;
+    if (c.bump == nullptr || c.bump + block > c.bump_end)
+    {
+        char* s = allocate_slab();
+        slab_header* h = reinterpret_cast<slab_header*>(s);
+        h->owner = heap;
+        // первый блок начинается после заголовка с выравниванием
+        // по младшему биту размера блока (не меньше 16)
+        size_t first = block & (~block + 1);
+        c.bump = s + ((sizeof(slab_header) + first - 1) / first) * first;
+        c.bump_end = s + slab_size;
+    }
+
+    void* p = c.bump;
+    c.bump += block;
+    return p;
+}
+
+// size и align те же, что при выделении
+inline void slab_deallocate(void* p, size_t size,
+                            size_t align = slab_granularity)
+{
+    if (p == nullptr)
+        return;
+    size = slab_aligned_size(size, align);
+    if (size > slab_max_block)
+    {
+        slab_delete(p, align);
+        return;
+    }
+
+    slab_header* h = reinterpret_cast<slab_header*>(
+                reinterpret_cast<uintptr_t>(p) &
+                ~(static_cast<uintptr_t>(slab_size) - 1));
+    slab_class& c = h->owner->classes[slab_class_index(size)];
+    slab_block* b = static_cast<slab_block*>(p);
+
+    // свой блок - в локальный список без атомарных операций
+    if (h->owner == slab_owner.current())
+    {
+        b->next = c.local;
+        c.local = b;
+        return;
+    }
+
+    // чужой - в удаленный список владельца
+    slab_block* head = c.remote.load(std::memory_order_relaxed);
+    do
+    {
+        b->next = head;
+    } while (!c.remote.compare_exchange_weak(head, b,
+                std::memory_order_release, std::memory_order_relaxed));
+}
+
+// политики выделения памяти для узлов контейнеров,
+// узел определяет operator new/delete через политику, поэтому
+// и отложенное удаление в SMR возвращает узел туда же.
+// align - alignof узла: узел с выровненными данными (alignas(64))
+// получает выровненную память
+struct global_allocation
+{
+    static void* allocate(size_t size, size_t align)
+    {
+        return slab_new(size, align);
+    }
+
+    static void deallocate(void* p, size_t, size_t align)
+    {
+        slab_delete(p, align);
+    }
+};
+
+struct slab_allocation
+{
+    static void* allocate(size_t size, size_t align)
+    {
+        return slab_allocate(size, align);
+    }
+
+    static void deallocate(void* p, size_t size, size_t align)
+    {
+        slab_deallocate(p, size, align);
+    }
+};
+
+} // namespace lock_free
+
+#endif // SLAB_ALLOCATOR_H
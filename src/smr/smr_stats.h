@@ -0,0 +1,62 @@
+#ifndef SMR_STATS_H
+#define SMR_STATS_H
+
+// статистика отложенного удаления, включается макросом
+// LOCK_FREE_SMR_STATS (общий атомарный счетчик на каждый retire,
+// поэтому только для измерений)
+
+#include <atomic>
+#include <cstddef>
+
+namespace lock_free {
+
+struct smr_stats
+{
+    std::atomic<long> retired;
+    std::atomic<long> reclaimed;
+    // байт в отложенных, но еще не удаленных объектах
+    // (после сброса может уйти в минус за счет ранее отложенных)
+    std::atomic<long> unreclaimed_bytes;
+    std::atomic<long> peak_unreclaimed_bytes;
+};
+
+smr_stats global_smr_stats;
+
+inline void smr_stats_reset()
+{
+    global_smr_stats.retired.store(0);
+    global_smr_stats.reclaimed.store(0);
+    global_smr_stats.unreclaimed_bytes.store(0);
+    global_smr_stats.peak_unreclaimed_bytes.store(0);
+}
+
+inline void smr_stats_on_retire(size_t bytes)
+{
+#ifdef LOCK_FREE_SMR_STATS
+    global_smr_stats.retired.fetch_add(1, std::memory_order_relaxed);
+    long curr = global_smr_stats.unreclaimed_bytes.fetch_add(
+                static_cast<long>(bytes), std::memory_order_relaxed) +
+                static_cast<long>(bytes);
+    long peak = global_smr_stats.peak_unreclaimed_bytes.load(
+                std::memory_order_relaxed);
+    while (curr > peak && !global_smr_stats.peak_unreclaimed_bytes
+           .compare_exchange_weak(peak, curr, std::memory_order_relaxed));
+#else
+    (void)bytes;
+#endif
+}
+
+inline void smr_stats_on_reclaim(size_t bytes)
+{
+#ifdef LOCK_FREE_SMR_STATS
+    global_smr_stats.reclaimed.fetch_add(1, std::memory_order_relaxed);
+    global_smr_stats.unreclaimed_bytes.fetch_sub(
+                static_cast<long>(bytes), std::memory_order_relaxed);
+#else
+    (void)bytes;
+#endif
+}
+
+} // namespace lock_free
+
+#endif // SMR_STATS_H
@@ -0,0 +1,45 @@
+#ifndef TAGGED_INDEX_H
+#define TAGGED_INDEX_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace lock_free {
+
+// меченый индекс для решения ABA-проблемы в контейнерах с узлами
+// в собственном массиве: 32-битный индекс узла и 32-битный tag,
+// который увеличивается при каждом изменении. Вместе это одно
+// 64-битное слово, поэтому CAS над ним не требует cmpxchg16b
+// и не может незаметно превратиться в блокировку в libatomic.
+// Индекс 0 - пустой указатель, узел i хранится под индексом i + 1
+struct tagged_index
+{
+    uint32_t index;
+    uint32_t tag;
+
+    tagged_index() noexcept: index(0), tag(0) { }
+    tagged_index(uint32_t i) noexcept: index(i), tag(0) { }
+    tagged_index(uint32_t i, uint32_t n) noexcept: index(i), tag(n) { }
+};
+
+static_assert(sizeof(tagged_index) == sizeof(uint64_t),
+              "tagged_index must fit in one 64-bit word");
+static_assert(std::atomic<tagged_index>::is_always_lock_free,
+              "std::atomic<tagged_index> must be lock-free");
+
+inline bool operator==(const tagged_index& a, const tagged_index& b)
+{
+    return a.index == b.index && a.tag == b.tag;
+}
+
+inline bool operator!=(const tagged_index& a, const tagged_index& b)
+{
+    return !(a == b);
+}
+
+// максимальное число узлов, адресуемых tagged_index
+const uint64_t max_tagged_nodes = UINT32_MAX;
+
+} // namespace lock_free
+
+#endif // TAGGED_INDEX_H
@@ -0,0 +1,373 @@
+#ifndef TAGGED_NODE_POOL_H
+#define TAGGED_NODE_POOL_H
+
+// пул узлов для контейнеров с меченым индексом (tagged_index).
+// Узлы выделяются блоками и никогда не освобождаются до удаления пула,
+// поэтому устаревший индекс всегда указывает на существующий узел
+// и ABA-проблему решает tag, как и с фиксированным массивом.
+// Макрос LOCK_FREE_HUGE_PAGES - блоки выделяются через mmap
+// с просьбой к ядру использовать huge pages (Linux)
+
+#include "backoff.h"
+#include "tagged_index.h"
+#include "thread_registry.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <thread>
+
+#ifdef LOCK_FREE_HUGE_PAGES
+#include <sys/mman.h>
+#endif
+
+namespace lock_free {
+
+// Node должен определять free_next() и set_free_next(uint32_t) -
+// связь в списке свободных узлов (обычно то же поле, что и next).
+// N - размер первого блока (округляется вверх до степени двойки,
+// чтобы номер блока по индексу считался сдвигами),
+// каждый следующий блок вдвое больше,
+// M - число магазинов (небольших кэшей свободных узлов потоков),
+// C - ожидание после неудачной CAS операции на общем списке
+template <typename Node, size_t N, size_t M = 16, typename C = no_backoff>
+class tagged_node_pool
+{
+    // log2 размера первого блока, округленный вверх
+    static constexpr size_t ceil_log2(size_t n)
+    {
+        return n <= 1 ? 0 : 1 + ceil_log2((n + 1) / 2);
+    }
+
+    static const size_t base_shift = ceil_log2(N);
+    static const size_t base_size = static_cast<size_t>(1) << base_shift;
+
+    static_assert(N > 0 && base_size <= max_tagged_nodes,
+                  "tagged_node_pool chunk size must fit in tagged_index");
+
+public:
+    tagged_node_pool(): chunk_count(0), added_chunks(0)
+    {
+        for (size_t i = 0; i < max_chunks; ++i)
+            chunks[i].store(nullptr);
+        for (size_t i = 0; i < M; ++i)
+        {
+            magazines[i].busy.store(false);
+            magazines[i].count = 0;
+        }
+
+        free_nodes.store(tagged_index());
+        grow();
+    }
+
+    tagged_node_pool(const tagged_node_pool&) = delete;
+    tagged_node_pool& operator=(const tagged_node_pool&) = delete;
+
+    ~tagged_node_pool()
+    {
+        size_t count = chunk_count.load();
+        for (size_t k = 0; k < max_chunks && k < count; ++k)
+        {
+            Node* chunk = chunks[k].load();
+            if (chunk == nullptr)
+                continue;
+            for (size_t j = 0; j < chunk_size(k); ++j)
+                chunk[j].~Node();
+            deallocate_chunk(chunk, chunk_size(k) * sizeof(Node));
+        }
+    }
+
+    // узел по индексу, 0 - nullptr
+    Node* at(uint32_t i) const
+    {
+        if (i == 0)
+            return nullptr;
+
+        // блок k содержит узлы [B * (2^k - 1), B * (2^(k+1) - 1)),
+        // B = base_size - степень двойки, деление заменяют сдвиги
+        size_t j = i - 1;
+        size_t k = highest_bit((j >> base_shift) + 1);
+        return chunks[k].load(std::memory_order_relaxed) +
+                (j - (((static_cast<size_t>(1) << k) - 1) << base_shift));
+    }
+
+    // индекс свободного узла, 0 - узлов больше нет
+    // (занято все адресное пространство tagged_index)
+    uint32_t get()
+    {
+        magazine* m = acquire_magazine();
+        if (m != nullptr)
+        {
+            if (m->count == 0)
+                refill(*m);
+            uint32_t i = m->count > 0 ? m->items[--m->count] : 0;
+            release_magazine(m);
+            if (i != 0)
+                return i;
+        }
+
+        while (true)
+        {
+            uint32_t first;
+            if (pop_chain(1, first) != 0)
+                return first;
+            if (!grow())
+                return 0;
+        }
+    }
+
+    void put(uint32_t i)
+    {
+        magazine* m = acquire_magazine();
+        if (m != nullptr)
+        {
+            if (m->count == magazine_size)
+                flush(*m);
+            m->items[m->count++] = i;
+            release_magazine(m);
+            return;
+        }
+
+        put_chain(i, i);
+    }
+
+    // возврат цепочки first..last, связанной через free_next,
+    // в общий список одной CAS операцией
+    void put_chain(uint32_t first, uint32_t last)
+    {
+        C backoff;
+        tagged_index new_top;
+        tagged_index curr = free_nodes.load();
+
+        while (true)
+        {
+            at(last)->set_free_next(curr.index);
+            new_top.tag = curr.tag + 1;
+            new_top.index = first;
+            if (free_nodes.compare_exchange_weak(curr, new_top))
+                return;
+            backoff();
+        }
+    }
+
+protected:
+    // блоков достаточно, чтобы исчерпать индексы tagged_index
+    static const size_t max_chunks = 32;
+    static const size_t magazine_size = 32;
+
+    // свободные узлы потока: берутся и возвращаются без обращения
+    // к общему free_nodes, с ним обмениваются половиной магазина.
+    // Поток выбирает магазин по номеру, при совпадении номеров
+    // (потоков больше M) занятый магазин пропускается
+    struct alignas(128) magazine
+    {
+        std::atomic<bool> busy;
+        size_t count;
+        uint32_t items[magazine_size];
+    };
+
+    alignas(128) std::atomic<tagged_index> free_nodes;
+    // chunk_count - номер следующего блока, его увеличивает поток,
+    // который добавляет блок; added_chunks - число блоков, уже
+    // отданных в общий список. Пока они не равны, блок добавляется
+    alignas(128) std::atomic<size_t> chunk_count;
+    std::atomic<size_t> added_chunks;
+    std::atomic<Node*> chunks[max_chunks];
+    magazine magazines[M];
+
+    static size_t chunk_size(size_t k)
+    {
+        return base_size << k;
+    }
+
+    // номер старшего единичного бита
+    static size_t highest_bit(size_t v)
+    {
+#if defined(__GNUC__)
+        return sizeof(unsigned long long) * 8 - 1 -
+               static_cast<size_t>(__builtin_clzll(v));
+#else
+        size_t r = 0;
+        while (v >>= 1)
+            ++r;
+        return r;
+#endif
+    }
+
+    magazine* acquire_magazine()
+    {
+        // номера живых потоков различны и небольшие,
+        // поэтому до M потоков магазины не делят
+        magazine& m = magazines[registered_thread_index() % M];
+        if (m.busy.load(std::memory_order_relaxed) ||
+                m.busy.exchange(true, std::memory_order_acquire))
+            return nullptr;
+        return &m;
+    }
+
+    static void release_magazine(magazine* m)
+    {
+        m->busy.store(false, std::memory_order_release);
+    }
+
+    // половина пустого магазина заполняется из общего списка
+    void refill(magazine& m)
+    {
+        uint32_t first;
+        size_t count;
+        while ((count = pop_chain(magazine_size / 2, first)) == 0)
+        {
+            if (!grow())
+                return;
+        }
+
+        for (uint32_t i = first; count > 0; --count)
+        {
+            m.items[m.count++] = i;
+            i = at(i)->free_next();
+        }
+    }
+
+    // половина полного магазина возвращается в общий список цепочкой
+    void flush(magazine& m)
+    {
+        size_t from = magazine_size / 2;
+        for (size_t i = from; i + 1 < magazine_size; ++i)
+            at(m.items[i])->set_free_next(m.items[i + 1]);
+        put_chain(m.items[from], m.items[magazine_size - 1]);
+        m.count = from;
+    }
+
+    // снятие до max узлов с вершины общего списка одной CAS операцией:
+    // пока tag вершины не изменился, никто не снимал узлы,
+    // и цепочка под ней та же, что прочитана.
+    // Возвращает число снятых узлов, first - первый из них
+    size_t pop_chain(size_t max, uint32_t& first)
+    {
+        C backoff;
+        tagged_index curr = free_nodes.load();
+
+        while (true)
+        {
+            if (curr.index == 0)
+                return 0;
+
+            uint32_t last = curr.index;
+            size_t count = 1;
+            for (; count < max; ++count)
+            {
+                uint32_t next = at(last)->free_next();
+                if (next == 0)
+                    break;
+                last = next;
+            }
+
+            tagged_index next(at(last)->free_next(), curr.tag + 1);
+            if (free_nodes.compare_exchange_weak(curr, next))
+            {
+                first = curr.index;
+                return count;
+            }
+            backoff();
+        }
+    }
+
+    // новый блок вдвое больше предыдущего целиком уходит в общий список.
+    // Блоки добавляются по одному: блок k выделяет поток, которому
+    // удалась CAS chunk_count k -> k + 1, остальные ждут, пока блок
+    // не попадет в общий список, и снова берут узлы оттуда.
+    // true - можно снова пробовать взять узел, false - индексы исчерпаны
+    bool grow()
+    {
+        size_t k = chunk_count.load();
+        while (true)
+        {
+            if (free_nodes.load().index != 0)
+                return true;
+
+            if (added_chunks.load() != k)
+            {
+                // блок добавляет другой поток
+                std::this_thread::yield();
+                k = chunk_count.load();
+                continue;
+            }
+
+            if (k >= max_chunks ||
+                    base_size * ((static_cast<size_t>(1) << (k + 1)) - 1) >
+                    max_tagged_nodes)
+                return false;
+
+            if (!chunk_count.compare_exchange_weak(k, k + 1))
+                continue;
+
+            // пока шла CAS, узлы могли вернуть в список: блок не нужен,
+            // ожидающие потоки увидят chunk_count == added_chunks
+            if (free_nodes.load().index != 0)
+            {
+                chunk_count.store(k);
+                return true;
+            }
+            break;
+        }
+
+        size_t size = chunk_size(k);
+        Node* chunk;
+        try
+        {
+            chunk = static_cast<Node*>(allocate_chunk(size * sizeof(Node)));
+        }
+        catch (...)
+        {
+            // ожидающие потоки не должны ждать блок, которого не будет
+            chunk_count.store(k);
+            throw;
+        }
+        uint32_t first = static_cast<uint32_t>(
+                    base_size * ((1ull << k) - 1)) + 1;
+        for (size_t j = 0; j < size; ++j)
+        {
+            new (&chunk[j]) Node();
+            chunk[j].set_free_next(j + 1 < size ?
+                                   first + static_cast<uint32_t>(j) + 1 : 0);
+        }
+
+        // блок публикуется до того, как его индексы попадут к другим потокам
+        chunks[k].store(chunk, std::memory_order_release);
+        put_chain(first, first + static_cast<uint32_t>(size) - 1);
+        added_chunks.store(k + 1);
+        return true;
+    }
+
+    static void* allocate_chunk(size_t bytes)
+    {
+#ifdef LOCK_FREE_HUGE_PAGES
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+        return p;
+#else
+        return ::operator new(bytes, std::align_val_t(128));
+#endif
+    }
+
+    static void deallocate_chunk(void* p, size_t bytes)
+    {
+#ifdef LOCK_FREE_HUGE_PAGES
+        munmap(p, bytes);
+#else
+        (void)bytes;
+        ::operator delete(p, std::align_val_t(128));
+#endif
+    }
+};
+
+} // namespace lock_free
+
+#endif // TAGGED_NODE_POOL_H
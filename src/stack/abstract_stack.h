@@ -1,14 +1,136 @@
 #ifndef ABSTRACT_STACK_H
 #define ABSTRACT_STACK_H
 
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 namespace lock_free {
 
+// статический интерфейс стека (CRTP): реализации наследуют
+// stack_base<реализация, T> и определяют push/pop, операции вызываются
+// напрямую и встраиваются. Пакетные операции по умолчанию поэлементные,
+// реализация может определить свои с тем же именем
+template <typename Derived, typename T>
+class stack_base
+{
+public:
+    using value_type = T;
+
+    // добавление элементов [first, last), возвращает число добавленных
+    size_t push_bulk(const T* first, const T* last)
+    {
+        size_t count = 0;
+        for (; first != last; ++first, ++count)
+        {
+            if (!derived().push(*first))
+                break;
+        }
+        return count;
+    }
+
+    // извлечение всех элементов в out (от вершины ко дну),
+    // возвращает число извлеченных
+    size_t pop_all(std::vector<T>& out)
+    {
+        size_t count = 0;
+        T value;
+        while (derived().pop(value))
+        {
+            out.push_back(std::move(value));
+            ++count;
+        }
+        return count;
+    }
+
+protected:
+    Derived& derived()
+    {
+        return static_cast<Derived&>(*this);
+    }
+};
+
+// проверка, что S реализует статический интерфейс стека
+template <typename S, typename = void>
+struct is_stack: std::false_type { };
+
+template <typename S>
+struct is_stack<S, typename std::enable_if<
+        std::is_base_of<stack_base<S, typename S::value_type>, S>::value>::type>:
+        std::true_type { };
+
+// динамический интерфейс стека, для выбора реализации во время работы
 template <typename T>
 class stack
 {
 public:
+    using value_type = T;
+
+    virtual ~stack() { }
+
     virtual bool push(const T& value) = 0;
+    virtual bool push(T&& value) = 0;
     virtual bool pop(T& result) = 0;
+    virtual size_t push_bulk(const T* first, const T* last) = 0;
+    virtual size_t pop_all(std::vector<T>& out) = 0;
+    // приблизительные при одновременных изменениях
+    virtual size_t size() const = 0;
+    virtual bool empty() const = 0;
+};
+
+// адаптер статической реализации S к динамическому интерфейсу stack<T>
+template <typename S>
+class stack_adapter final: public stack<typename S::value_type>
+{
+    static_assert(is_stack<S>::value,
+                  "S must derive from lock_free::stack_base<S, T>");
+
+public:
+    using T = typename S::value_type;
+
+    bool push(const T& value) override
+    {
+        return impl.push(value);
+    }
+
+    bool push(T&& value) override
+    {
+        return impl.push(std::move(value));
+    }
+
+    bool pop(T& result) override
+    {
+        return impl.pop(result);
+    }
+
+    size_t push_bulk(const T* first, const T* last) override
+    {
+        return impl.push_bulk(first, last);
+    }
+
+    size_t pop_all(std::vector<T>& out) override
+    {
+        return impl.pop_all(out);
+    }
+
+    size_t size() const override
+    {
+        return impl.size();
+    }
+
+    bool empty() const override
+    {
+        return impl.empty();
+    }
+
+    S& get()
+    {
+        return impl;
+    }
+
+protected:
+    S impl;
 };
 
 } // namespace lock_free
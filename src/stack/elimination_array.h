@@ -0,0 +1,229 @@
+#ifndef ELIMINATION_ARRAY_H
+#define ELIMINATION_ARRAY_H
+
+// based on Hendler, Shavit and Yerushalmi's
+// "A scalable lock-free stack algorithm" (elimination backoff)
+
+#include "thread_registry.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <utility>
+
+namespace lock_free {
+
+// политика стека без исключения операций
+template <typename T>
+struct no_elimination
+{
+    bool exchange_push(T&)
+    {
+        return false;
+    }
+
+    bool exchange_pop(T&)
+    {
+        return false;
+    }
+};
+
+// массив исключения: после неудачной CAS операции на вершине стека
+// push и pop встречаются в случайной ячейке и взаимно уничтожаются,
+// не обращаясь к вершине. push выкладывает в ячейку значение в своем
+// блоке памяти, pop забирает блок вместе со значением (передача
+// владения, как в обменнике Hendler-Shavit-Yerushalmi): ни одна
+// сторона не ждет другую после встречи.
+// Число используемых ячеек и время ожидания подстраиваются
+// под нагрузку отдельно в каждом потоке для каждого массива.
+// N - максимальное число ячеек
+template <typename T, size_t N = 16>
+class elimination_array
+{
+public:
+    elimination_array()
+    {
+        for (size_t i = 0; i < N; ++i)
+            slots[i].item.store(nullptr);
+        for (size_t i = 0; i < max_registered_threads; ++i)
+            states[i].state.seed = (i + 1) * 0x9E3779B97F4A7C15ull;
+    }
+
+    elimination_array(const elimination_array&) = delete;
+    elimination_array& operator=(const elimination_array&) = delete;
+
+    // value предлагается для pop,
+    // true - значение забрал pop (перемещением)
+    bool exchange_push(T& value)
+    {
+        adaptive_state& st = get_state();
+        slot& s = slots[st.next_index()];
+
+        if (s.item.load() != nullptr)
+        {
+            // ячейка занята: операций много, расширяем диапазон
+            st.collision();
+            return false;
+        }
+
+        offer* o = new offer(std::move(value));
+        void* expected = nullptr;
+        if (!s.item.compare_exchange_strong(expected, o))
+        {
+            value = std::move(o->value);
+            delete o;
+            st.collision();
+            return false;
+        }
+
+        for (unsigned i = 0; i < st.spins; ++i)
+        {
+            if (s.item.load() == taken())
+                break;
+            std::this_thread::yield();
+        }
+
+        // пары не нашлось, забираем предложение
+        expected = o;
+        if (s.item.compare_exchange_strong(expected, nullptr))
+        {
+            value = std::move(o->value);
+            delete o;
+            st.timeout();
+            return false;
+        }
+
+        // блок уже у pop. Пока ячейка помечена taken, в нее не попадет
+        // новое предложение, поэтому освобождает ее только этот push
+        s.item.store(nullptr);
+        st.success();
+        return true;
+    }
+
+    // true - значение получено от push
+    bool exchange_pop(T& result)
+    {
+        adaptive_state& st = get_state();
+        slot& s = slots[st.next_index()];
+
+        for (unsigned i = 0; i < st.spins; ++i)
+        {
+            void* p = s.item.load();
+            if (p != nullptr && p != taken())
+            {
+                // блок читается только после успешной CAS: до нее
+                // push мог забрать предложение и удалить блок
+                if (!s.item.compare_exchange_strong(p, taken()))
+                {
+                    st.collision();
+                    return false;
+                }
+
+                offer* o = static_cast<offer*>(p);
+                result = std::move(o->value);
+                delete o;
+                st.success();
+                return true;
+            }
+            std::this_thread::yield();
+        }
+
+        st.timeout();
+        return false;
+    }
+
+protected:
+    static const unsigned min_spins = 4;
+    static const unsigned max_spins = 256;
+
+    // значение, предложенное push
+    struct offer
+    {
+        T value;
+
+        explicit offer(T&& v): value(std::move(v)) { }
+    };
+
+    // ячейка: nullptr - свободна, offer - предложение push,
+    // taken - pop забрал предложение, ячейку освобождает push
+    struct alignas(128) slot
+    {
+        std::atomic<void*> item;
+    };
+
+    slot slots[N];
+
+    static void* taken()
+    {
+        static char tag;
+        return &tag;
+    }
+
+    // диапазон ячеек и время ожидания потока:
+    // столкновения расширяют диапазон, неудачное ожидание сужает его
+    // и сокращает время ожидания, встреча увеличивает время ожидания
+    struct adaptive_state
+    {
+        size_t range;
+        unsigned spins;
+        size_t seed;
+
+        explicit adaptive_state(size_t s = 1):
+            range(1), spins(min_spins), seed(s) { }
+
+        size_t next_index()
+        {
+            // xorshift
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            return seed % range;
+        }
+
+        void collision()
+        {
+            if (range < N)
+                range *= 2;
+        }
+
+        void timeout()
+        {
+            if (range > 1)
+                range /= 2;
+            if (spins > min_spins)
+                spins /= 2;
+        }
+
+        void success()
+        {
+            if (spins < max_spins)
+                spins *= 2;
+        }
+    };
+
+    // состояние потока в этом массиве: в разных стеках нагрузка разная,
+    // поэтому у каждого массива свои ячейки состояний по номерам потоков
+    adaptive_state& get_state()
+    {
+        size_t i = registered_thread_index();
+        if (i < max_registered_threads)
+            return states[i].state;
+
+        // номера кончились: общее для всех массивов состояние потока
+        thread_local static adaptive_state overflow(
+                std::hash<std::thread::id>()(std::this_thread::get_id()) | 1);
+        return overflow;
+    }
+
+    struct alignas(64) state_slot
+    {
+        adaptive_state state;
+    };
+
+    state_slot states[max_registered_threads];
+};
+
+} // namespace lock_free
+
+#endif // ELIMINATION_ARRAY_H
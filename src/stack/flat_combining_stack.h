@@ -0,0 +1,149 @@
+#ifndef FLAT_COMBINING_STACK_H
+#define FLAT_COMBINING_STACK_H
+
+#include "abstract_stack.h"
+#include "flat_combiner.h"
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace lock_free {
+
+// стек с flat combining: операции потоков выполняет один поток
+// над std::vector, без malloc на каждый push и без CAS на вершине.
+// N - число ячеек публикации запросов
+template <typename T, size_t N = 64>
+class flat_combining_stack: public stack_base<flat_combining_stack<T, N>, T>
+{
+public:
+    flat_combining_stack(): count(0)
+    {
+        data.reserve(initial_capacity);
+    }
+
+    bool push(const T& value)
+    {
+        request r(push_copy);
+        r.first = &value;
+        r.last = &value + 1;
+        return execute(r) != 0;
+    }
+
+    bool push(T&& value)
+    {
+        request r(push_move);
+        r.out = &value;
+        return execute(r) != 0;
+    }
+
+    template <typename... Args>
+    bool emplace(Args&&... args)
+    {
+        T value(std::forward<Args>(args)...);
+        return push(std::move(value));
+    }
+
+    bool pop(T& result)
+    {
+        request r(pop_one);
+        r.out = &result;
+        return execute(r) != 0;
+    }
+
+    // все элементы добавляются одним запросом
+    size_t push_bulk(const T* first, const T* last)
+    {
+        if (first == last)
+            return 0;
+        request r(push_copy);
+        r.first = first;
+        r.last = last;
+        return execute(r);
+    }
+
+    size_t pop_all(std::vector<T>& out)
+    {
+        request r(pop_all_items);
+        r.all = &out;
+        return execute(r);
+    }
+
+    // размер, записанный combiner после последнего прохода
+    size_t size() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+protected:
+    static const size_t initial_capacity = 1024;
+
+    enum kind { push_copy, push_move, pop_one, pop_all_items };
+
+    struct request
+    {
+        kind op;
+        const T* first;
+        const T* last;
+        T* out;
+        std::vector<T>* all;
+        size_t count;
+
+        request(kind k):
+            op(k), first(nullptr), last(nullptr),
+            out(nullptr), all(nullptr), count(0) { }
+    };
+
+    flat_combiner<request, N> combiner;
+    // читается и изменяется только потоком-combiner
+    std::vector<T> data;
+    // копия data.size() для чтения без блокировки, пишет только combiner
+    std::atomic<size_t> count;
+
+    size_t execute(request& r)
+    {
+        combiner.execute(r, [this](request& q) { apply(q); });
+        return r.count;
+    }
+
+    void apply(request& r)
+    {
+        switch (r.op)
+        {
+        case push_copy:
+            data.insert(data.end(), r.first, r.last);
+            r.count = r.last - r.first;
+            break;
+        case push_move:
+            data.push_back(std::move(*r.out));
+            r.count = 1;
+            break;
+        case pop_one:
+            if (!data.empty())
+            {
+                *r.out = std::move(data.back());
+                data.pop_back();
+                r.count = 1;
+            }
+            break;
+        case pop_all_items:
+            // от вершины ко дну
+            r.count = data.size();
+            for (size_t i = data.size(); i > 0; --i)
+                r.all->push_back(std::move(data[i - 1]));
+            data.clear();
+            break;
+        }
+        count.store(data.size(), std::memory_order_relaxed);
+    }
+};
+
+} // namespace lock_free
+
+#endif // FLAT_COMBINING_STACK_H
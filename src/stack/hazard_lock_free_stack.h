@@ -2,16 +2,29 @@
 #define HAZARD_LOCK_FREE_STACK_H
 
 #include "abstract_stack.h"
+#include "backoff.h"
+#include "elimination_array.h"
 #include "hazard_pointer.h"
+#include "slab_allocator.h"
+#include "striped_counter.h"
 
 #include <atomic>
 #include <memory>
+#include <utility>
 
 namespace lock_free {
 
-// lock-free стек с использованием опасных указателей (hazard pointers)
-template <typename T>
-class hazard_lock_free_stack: public stack<T>
+// lock-free стек с использованием опасных указателей (hazard pointers),
+// R - политика освобождения памяти (hazard_reclamation, epoch_reclamation),
+// E - исключение push/pop при конкуренции (no_elimination, elimination_array),
+// C - ожидание после неудачной CAS операции (no_backoff, exponential_backoff,
+// proportional_backoff),
+// A - выделение памяти узлов (global_allocation, slab_allocation)
+template <typename T, typename R = hazard_reclamation,
+          typename E = no_elimination<T>, typename C = no_backoff,
+          typename A = global_allocation>
+class hazard_lock_free_stack:
+        public stack_base<hazard_lock_free_stack<T, R, E, C, A>, T>
 {
 public:
     hazard_lock_free_stack()
@@ -19,54 +32,166 @@ public:
         stack_head.store(nullptr);
     }
 
-    bool push(const T& value) override
+    bool push(const T& value)
     {
-        node* new_node = new node();
-        new_node->data = value;
+        return emplace(value);
+    }
+
+    bool push(T&& value)
+    {
+        return emplace(std::move(value));
+    }
+
+    // элемент создается сразу в узле
+    template <typename... Args>
+    bool emplace(Args&&... args)
+    {
+        node* new_node = new node(std::forward<Args>(args)...);
+        C backoff;
         new_node->next = stack_head.load();
         // передвигаем stack_head на new_node
-        while (!stack_head.compare_exchange_weak(new_node->next, new_node));
+        while (!stack_head.compare_exchange_weak(new_node->next, new_node))
+        {
+            // при конкуренции пробуем встретиться с pop
+            if (elimination.exchange_push(new_node->data))
+            {
+                delete new_node;
+                elements.increment();
+                return true;
+            }
+            backoff();
+        }
+        elements.increment();
         return true;
     }
 
-    bool pop(T& result) override
+    bool pop(T& result)
     {
-        std::atomic<void*>& hp = get_hazard_pointer_for_current_thread(0);
+        typename R::guard g;
+        C backoff;
 
-        node* head = stack_head.load();
-        do
+        node* head;
+        while (true)
         {
-            node* temp;
-            do
+            // отмечаем head как hazard
+            head = g.protect(0, stack_head);
+            if (!head || stack_head.compare_exchange_strong(head, head->next))
+                break;
+
+            // при конкуренции пробуем встретиться с push
+            if (elimination.exchange_pop(result))
             {
-                temp = head;
-                // отмечаем head как hazard
-                hp.store(head);
-                head = stack_head.load();
-            } while (head != temp);
-        } while (head && !stack_head.compare_exchange_strong(head, head->next));
+                elements.decrement();
+                return true;
+            }
+            backoff();
+        }
 
         // stack_head передвинули на head->next
         // можно обнулить hazard указатель
-        hp.store(nullptr);
+        g.clear(0);
         if (head)
         {
-            result = head->data;
-            reclaim_later(head);
+            // узел принадлежит только этому потоку, данные перемещаются
+            result = std::move(head->data);
+            R::retire(head);
+            elements.decrement();
 
             return true;
         }
         return false;
     }
 
+    // цепочка узлов собирается заранее
+    // и публикуется одной CAS операцией на stack_head
+    size_t push_bulk(const T* first, const T* last)
+    {
+        if (first == last)
+            return 0;
+
+        node* top = nullptr;
+        node* bottom = nullptr;
+        for (const T* p = first; p != last; ++p)
+        {
+            node* new_node = new node(*p);
+            new_node->next = top;
+            top = new_node;
+            if (bottom == nullptr)
+                bottom = new_node;
+        }
+
+        C backoff;
+        bottom->next = stack_head.load();
+        while (!stack_head.compare_exchange_weak(bottom->next, top))
+            backoff();
+        elements.add(last - first);
+        return last - first;
+    }
+
+    // весь стек забирается одной операцией exchange
+    size_t pop_all(std::vector<T>& out)
+    {
+        node* head = stack_head.exchange(nullptr);
+
+        // узлы уже недоступны через stack_head, но другие потоки
+        // могут читать head->next в pop, поэтому удаление откладывается
+        size_t count = 0;
+        while (head)
+        {
+            node* next = head->next;
+            out.push_back(std::move(head->data));
+            R::retire(head);
+            head = next;
+            ++count;
+        }
+        elements.add(-static_cast<int64_t>(count));
+        return count;
+    }
+
+    // число элементов по счетчику (см. striped_counter)
+    size_t size() const
+    {
+        return elements.size();
+    }
+
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
+
+    bool empty() const
+    {
+        return stack_head.load() == nullptr;
+    }
+
 protected:
-    struct node
+    struct node: reclaimable
     {
         T data;
         node* next;
+
+        template <typename... Args>
+        node(Args&&... args): data(std::forward<Args>(args)...) { }
+
+        // узел выделяется и удаляется (в том числе отложенно в SMR)
+        // через политику A
+        static void* operator new(size_t size)
+        {
+            return A::allocate(size, alignof(node));
+        }
+
+        static void operator delete(void* p, size_t size)
+        {
+            A::deallocate(p, size, alignof(node));
+        }
     };
 
     std::atomic<node*> stack_head;
+    E elimination;
+    striped_counter<> elements;
 };
 
 } // namespace lock_free
@@ -6,31 +6,74 @@
 #include <list>
 #include <mutex>
 #include <stack>
+#include <utility>
 
 namespace lock_free {
 
 // thread-safe стек с блокировкой (std::mutex)
 template <typename T>
-class lock_based_stack: public stack<T>
+class lock_based_stack: public stack_base<lock_based_stack<T>, T>
 {
 public:
-    bool push(const T& value) override
+    bool push(const T& value)
     {
         std::lock_guard<std::mutex> lock(m);
         data.push(value);
         return true;
     }
 
-    bool pop(T& result) override
+    bool push(T&& value)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        data.push(std::move(value));
+        return true;
+    }
+
+    template <typename... Args>
+    bool emplace(Args&&... args)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        data.emplace(std::forward<Args>(args)...);
+        return true;
+    }
+
+    bool pop(T& result)
     {
         std::lock_guard<std::mutex> lock(m);
         if (data.empty())
             return false;
-        result = data.top();
+        result = std::move(data.top());
         data.pop();
         return true;
     }
 
+    // одна блокировка на все элементы
+    size_t push_bulk(const T* first, const T* last)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        for (const T* p = first; p != last; ++p)
+            data.push(*p);
+        return last - first;
+    }
+
+    size_t pop_all(std::vector<T>& out)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        size_t count = data.size();
+        while (!data.empty())
+        {
+            out.push_back(std::move(data.top()));
+            data.pop();
+        }
+        return count;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(m);
+        return data.size();
+    }
+
     bool empty() const
     {
         std::lock_guard<std::mutex> lock(m);
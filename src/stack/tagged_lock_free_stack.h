@@ -2,103 +2,232 @@
 #define TAGGED_LOCK_FREE_STACK_H
 
 #include "abstract_stack.h"
+#include "backoff.h"
+#include "elimination_array.h"
+#include "striped_counter.h"
+#include "tagged_index.h"
+#include "tagged_node_pool.h"
 
-#include <array>
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <utility>
 
 namespace lock_free {
 
-// lock-free стек с использованием меченых указателей (tagged pointers)
-template <typename T, size_t N = 100>
-class tagged_lock_free_stack: public stack<T>
+// lock-free стек с использованием меченых указателей (tagged pointers):
+// ссылки на узлы - 32-битные индексы в пуле узлов с 32-битным tag
+// (tagged_index), CAS всегда над одним 64-битным словом.
+// Пул растет по мере надобности, узлы в нем не освобождаются.
+// N - размер первого блока пула,
+// E - исключение push/pop при конкуренции (no_elimination, elimination_array),
+// C - ожидание после неудачной CAS операции (no_backoff, exponential_backoff,
+// proportional_backoff)
+template <typename T, size_t N = 100, typename E = no_elimination<T>,
+          typename C = no_backoff>
+class tagged_lock_free_stack:
+        public stack_base<tagged_lock_free_stack<T, N, E, C>, T>
 {
 public:
     tagged_lock_free_stack()
     {
-        head.store(tagged_pointer());
-
-        for (size_t i = 0; i < N - 1; ++i)
-            node_storage[i].next.ptr = &node_storage[i + 1];
-
-        node_storage[N - 1].next = tagged_pointer();
-        free_nodes.store(tagged_pointer(&node_storage[0]));
+        head.store(tagged_index());
     }
 
-    bool push(const T& value) override
+    bool push(const T& value)
     {
-        node* new_node = get(free_nodes);
-        if (new_node == nullptr)
+        uint32_t i = nodes.get();
+        if (i == 0)
             return false;
-        new_node->data = value;
-        put(head, new_node);
+        nodes.at(i)->data = value;
+        push_node(i);
+        elements.increment();
         return true;
     }
 
-    bool pop(T& result) override
+    bool push(T&& value)
     {
-        node* node = get(head);
-        if (node == nullptr)
+        uint32_t i = nodes.get();
+        if (i == 0)
             return false;
-        result = node->data;
-        put(free_nodes, node);
+        nodes.at(i)->data = std::move(value);
+        push_node(i);
+        elements.increment();
         return true;
     }
 
-protected:
-    struct node;
+    bool pop(T& result)
+    {
+        C backoff;
+        tagged_index next;
+        tagged_index curr = head.load();
+
+        while (true)
+        {
+            if (curr.index == 0)
+                return false;
+            next.tag = curr.tag + 1;
+            next.index = nodes.at(curr.index)->free_next();
+            if (head.compare_exchange_strong(curr, next))
+                break;
+
+            // при конкуренции пробуем встретиться с push
+            if (elimination.exchange_pop(result))
+            {
+                elements.decrement();
+                return true;
+            }
+            backoff();
+            curr = head.load();
+        }
+
+        // узел снят со стека и принадлежит только этому потоку
+        result = std::move(nodes.at(curr.index)->data);
+        nodes.put(curr.index);
+        elements.decrement();
+        return true;
+    }
 
-    // для решения ABA-проблемы
-    // увеличиваем tag каждый раз при работе с указателем
-    struct tagged_pointer
+    // цепочка из свободных узлов публикуется одной CAS операцией,
+    // если индексы пула исчерпаны, добавляется только часть элементов
+    size_t push_bulk(const T* first, const T* last)
     {
-        node* ptr;
-        uintptr_t tag;
+        uint32_t top = 0;
+        uint32_t bottom = 0;
+        size_t count = 0;
+        for (; first != last; ++first, ++count)
+        {
+            uint32_t i = nodes.get();
+            if (i == 0)
+                break;
+            node* new_node = nodes.at(i);
+            new_node->data = *first;
+            new_node->set_free_next(top);
+            top = i;
+            if (bottom == 0)
+                bottom = i;
+        }
+
+        if (top != 0)
+            link_chain(top, bottom);
+        elements.add(count);
+        return count;
+    }
 
-        tagged_pointer() noexcept: ptr(nullptr), tag(0) { }
-        tagged_pointer(node* p) noexcept: ptr(p), tag(0) { }
-        tagged_pointer(node* p, uintptr_t n) noexcept: ptr(p), tag(n) { }
-    };
+    // весь стек забирается одной CAS операцией,
+    // узлы возвращаются в пул тоже одной
+    size_t pop_all(std::vector<T>& out)
+    {
+        C backoff;
+        tagged_index curr = head.load();
+        while (curr.index != 0 && !head.compare_exchange_weak(curr,
+                tagged_index(0, curr.tag + 1)))
+            backoff();
+
+        uint32_t bottom = 0;
+        size_t count = 0;
+        for (uint32_t i = curr.index; i != 0;
+             i = nodes.at(i)->free_next(), ++count)
+        {
+            out.push_back(std::move(nodes.at(i)->data));
+            bottom = i;
+        }
+
+        if (curr.index != 0)
+            nodes.put_chain(curr.index, bottom);
+        elements.add(-static_cast<int64_t>(count));
+        return count;
+    }
 
+    // число элементов по счетчику (см. striped_counter)
+    size_t size() const
+    {
+        return elements.size();
+    }
+
+    // число элементов в один момент времени (double collect, см.
+    // striped_counter::exact_sum): дороже size(), пока идут
+    // изменения, чтение повторяется
+    size_t exact_size() const
+    {
+        return elements.exact_size();
+    }
+
+    bool empty() const
+    {
+        return head.load().index == 0;
+    }
+
+protected:
     struct node
     {
         T data;
-        tagged_pointer next;
+        // индекс следующего узла в стеке или в списке свободных,
+        // читается конкурентно в pop, устаревшее значение
+        // отбрасывается CAS по tag
+        std::atomic<uint32_t> next;
+
+        uint32_t free_next() const
+        {
+            return next.load(std::memory_order_relaxed);
+        }
+
+        void set_free_next(uint32_t i)
+        {
+            next.store(i, std::memory_order_relaxed);
+        }
     };
 
-    alignas(128) std::atomic<tagged_pointer> head;
-    alignas(128) std::atomic<tagged_pointer> free_nodes;
+    alignas(128) std::atomic<tagged_index> head;
+    E elimination;
+    striped_counter<> elements;
 
-    // список свободных элементов
-    // вместо удаления помещаем элемент в node_storage
-    std::array<node, N> node_storage;
+    // вместо удаления узлы возвращаются в пул
+    tagged_node_pool<node, N, 16, C> nodes;
 
-    node* get(std::atomic<tagged_pointer>& top)
+    // добавление узла i с данными в head: при конкуренции данные
+    // могут забрать pop через elimination, тогда узел снова свободен
+    void push_node(uint32_t i)
     {
-        tagged_pointer next;
-        tagged_pointer curr = top.load();
+        C backoff;
+        node* new_node = nodes.at(i);
+        tagged_index new_top;
+        tagged_index curr = head.load();
 
-        do
+        while (true)
         {
-            if (curr.ptr == nullptr)
-                return nullptr;
-            next.tag = curr.tag + 1;
-            next.ptr = curr.ptr->next.ptr;
-        } while (!top.compare_exchange_weak(curr, next));
-        return curr.ptr;
+            new_node->set_free_next(curr.index);
+            new_top.tag = curr.tag + 1;
+            new_top.index = i;
+            if (head.compare_exchange_strong(curr, new_top))
+                return;
+
+            if (elimination.exchange_push(new_node->data))
+            {
+                nodes.put(i);
+                return;
+            }
+            backoff();
+            curr = head.load();
+        }
     }
 
-    void put(std::atomic<tagged_pointer>& top, node* node)
+    // добавление цепочки first..last, связанной через next, в head
+    void link_chain(uint32_t first, uint32_t last)
     {
-        tagged_pointer new_top;
-        tagged_pointer curr = top.load();
+        C backoff;
+        tagged_index new_top;
+        tagged_index curr = head.load();
 
-        do
+        while (true)
         {
-            node->next = curr.ptr;
+            nodes.at(last)->set_free_next(curr.index);
             new_top.tag = curr.tag + 1;
-            new_top.ptr = node;
-        } while (!top.compare_exchange_weak(curr, new_top));
+            new_top.index = first;
+            if (head.compare_exchange_weak(curr, new_top))
+                return;
+            backoff();
+        }
     }
 };
 
@@ -1,27 +1,131 @@
+// счетчики отложенного удаления для сравнения hazard pointers и эпох
+#define LOCK_FREE_SMR_STATS
+
+#include "epoch_based.h"
+#include "smr_stats.h"
+
 #include "tagged_lock_free_stack.h"
 #include "lock_based_stack.h"
+#include "flat_combining_stack.h"
 #include "hazard_lock_free_stack.h"
 
+#include "bounded_lock_free_queue.h"
+#include "flat_combining_queue.h"
 #include "hazard_lock_free_queue.h"
 #include "lock_based_queue.h"
+#include "mpsc_lock_free_queue.h"
+#include "segmented_lock_free_queue.h"
+#include "spsc_lock_free_queue.h"
 #include "tagged_lock_free_queue.h"
 
+#include "chase_lev_deque.h"
+#include "striped_counter.h"
+#include "lock_based_map.h"
+#include "lock_free_skip_list.h"
+#include "work_stealing_executor.h"
+
 #include "lock_free_hash_table.h"
 #include "locked_hash_table.h"
+#include "open_addressing_hash_table.h"
+#include "split_ordered_hash_table.h"
 #include "tbb/concurrent_hash_map.h"
 #include "hash.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdlib>
 #include <future>
 #include <iostream>
 #include <memory>
 #include <random>
+#include <string>
 #include <thread>
+#include <utility>
+#include <new>
 #include <vector>
 
 using namespace lock_free;
 
+// подсчет выделений памяти в текущем потоке
+thread_local size_t thread_allocations = 0;
+
+#if defined(__GNUC__)
+#define LF_NOINLINE __attribute__((noinline))
+#else
+#define LF_NOINLINE
+#endif
+
+LF_NOINLINE void* operator new(std::size_t size)
+{
+    ++thread_allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+LF_NOINLINE void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+LF_NOINLINE void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+LF_NOINLINE void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+LF_NOINLINE void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+LF_NOINLINE void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// выделения с выравниванием (узлы и сегменты с alignas)
+LF_NOINLINE void* operator new(std::size_t size, std::align_val_t al)
+{
+    ++thread_allocations;
+    std::size_t align = static_cast<std::size_t>(al);
+    if (void* p = std::aligned_alloc(align, (size + align - 1) & ~(align - 1)))
+        return p;
+    throw std::bad_alloc();
+}
+
+LF_NOINLINE void* operator new[](std::size_t size, std::align_val_t al)
+{
+    return operator new(size, al);
+}
+
+LF_NOINLINE void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+LF_NOINLINE void operator delete(void* p, std::size_t,
+                                 std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+LF_NOINLINE void operator delete[](void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+LF_NOINLINE void operator delete[](void* p, std::size_t,
+                                   std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
 // параметры теста:
 const int num_elements   = 256;
 const int num_threads    = 4;
@@ -40,13 +144,13 @@ int extra_work()
     return sum;
 }
 
-template <typename T>
-void lfht_test()
+template <typename T, typename Table>
+void lfht_test(const char* name)
 {
     std::cout << "=========" << std::endl;
-    std::cout << "lock-free" << std::endl;
+    std::cout << name << std::endl;
 
-    lock_free_hash_table<key, T, my_hash> lfht;
+    Table lfht;
 
     int sum1 = 0;
     for (int i = 0; i < num_elements; ++i)
@@ -166,7 +270,7 @@ void tbb_test()
     std::cout << "==========" << std::endl;
     std::cout << "tbb" << std::endl;
 
-    using table = tbb::concurrent_hash_map<key, T, my_hash>;
+    using table = tbb::concurrent_hash_map<key, T, hash_compare<key>>;
     table ht;
 
     int sum1 = 0;
@@ -231,22 +335,190 @@ void tbb_test()
     std::cout << "work time: " << (time * 1000) << "ms" << std::endl;
 }
 
-template <template <class> class Container, typename T,
-          typename Put, typename Get>
-bool container_test(std::vector<std::unique_ptr<Container<T>>> &containers,
-                    Put put, Get get,
+// проверка таблиц с ключами произвольного типа (строки, 128-битные id)
+template <typename Table, typename MakeKey>
+bool keys_test(const char* name, MakeKey make_key)
+{
+    std::cout << "==========" << std::endl;
+    std::cout << name << std::endl;
+
+    Table ht;
+    bool correct = true;
+
+    for (int i = 0; i < num_elements; ++i)
+        correct &= ht.hash_insert(make_key(i), i);
+
+    for (int i = 0; i < num_elements; i += 2)
+        correct &= (ht.hash_delete(make_key(i)) != 0);
+
+    for (int i = 0; i < num_elements; ++i)
+    {
+        int val = -1;
+        bool found = ht.hash_search(make_key(i), val);
+        correct &= (found == (i % 2 == 1)) && (!found || val == i);
+    }
+
+    if (correct) std::cout << "correct" << std::endl;
+    else std::cout << "error" << std::endl;
+
+    return correct;
+}
+
+// повторная вставка удаленных ключей в таблицу с открытой адресацией:
+// tombstone ключа занимается снова, массив не переносится, а поиск
+// не видит значение, переписанное наполовину
+struct versioned_value
+{
+    int first;
+    int second;
+    char data[120];
+};
+
+template <typename Table>
+void tombstone_reuse_test(const char* name)
+{
+    std::cout << "==========" << std::endl;
+    std::cout << name << std::endl;
+
+    const int keys = 64;
+    Table ht(1024);
+    for (int i = 0; i < keys; ++i)
+        ht.hash_insert(key(i), versioned_value{0, 0, {}});
+    size_t capacity = ht.capacity();
+
+    std::atomic<bool> done(false);
+    std::atomic<bool> torn(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; ++t)
+        workers.emplace_back([&, t]()
+        {
+            std::mt19937 gen(t + 1);
+            for (int n = 1; n <= num_operations * 10; ++n)
+            {
+                int k = static_cast<int>(gen() % keys);
+                if (ht.hash_delete(key(k)))
+                    ht.hash_insert(key(k), versioned_value{n, n, {}});
+            }
+        });
+    std::thread reader([&]()
+    {
+        std::mt19937 gen(0);
+        versioned_value v;
+        while (!done.load())
+        {
+            if (ht.hash_search(key(static_cast<int>(gen() % keys)), v) &&
+                    v.first != v.second)
+                torn.store(true);
+        }
+    });
+
+    for (auto& w : workers)
+        w.join();
+    done.store(true);
+    reader.join();
+
+    bool correct = !torn.load() && ht.capacity() == capacity &&
+                   ht.size() == size_t(keys);
+    std::cout << (correct ? "correct" : "error") << ", capacity: "
+              << capacity << " -> " << ht.capacity() << std::endl;
+}
+
+// поиск во время переноса: писатели вставляют и удаляют свои ключи,
+// таблица много раз переносится в новые массивы, читатель ищет
+// постоянные ключи и должен находить их всегда с верным значением
+template <typename Table>
+void migration_search_test(const char* name)
+{
+    std::cout << "==========" << std::endl;
+    std::cout << name << std::endl;
+
+    const int keys = 256;
+    Table ht(16);
+    for (int i = 0; i < keys; ++i)
+        ht.hash_insert(key(i), i);
+    size_t capacity = ht.capacity();
+
+    std::atomic<bool> done(false);
+    std::atomic<bool> lost(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; ++t)
+        workers.emplace_back([&, t]()
+        {
+            int base = keys + t * num_operations;
+            for (int n = 0; n < num_operations; ++n)
+                ht.hash_insert(key(base + n), n);
+            for (int n = 0; n < num_operations; ++n)
+                ht.hash_delete(key(base + n));
+        });
+    std::thread reader([&]()
+    {
+        int v;
+        for (int i = 0; !done.load(); i = (i + 1) % keys)
+        {
+            if (!ht.hash_search(key(i), v) || v != i)
+                lost.store(true);
+        }
+    });
+
+    for (auto& w : workers)
+        w.join();
+    done.store(true);
+    reader.join();
+
+    bool correct = !lost.load() && ht.size() == size_t(keys);
+    std::cout << (correct ? "correct" : "error") << ", capacity: "
+              << capacity << " -> " << ht.capacity() << std::endl;
+}
+
+// операции стека и очереди для шаблонного драйвера тестов:
+// вызываются напрямую у типа контейнера, без виртуальных вызовов
+// и указателей на методы (для stack<T>/queue<T> - виртуальные)
+struct stack_ops
+{
+    template <typename S, typename V>
+    static bool put(S& s, V&& value)
+    {
+        return s.push(std::forward<V>(value));
+    }
+
+    template <typename S, typename V>
+    static bool get(S& s, V& result)
+    {
+        return s.pop(result);
+    }
+};
+
+struct queue_ops
+{
+    template <typename Q, typename V>
+    static bool put(Q& q, V&& value)
+    {
+        return q.enqueue(std::forward<V>(value));
+    }
+
+    template <typename Q, typename V>
+    static bool get(Q& q, V& result)
+    {
+        return q.dequeue(result);
+    }
+};
+
+template <typename Ops, typename Container>
+bool container_test(std::vector<std::unique_ptr<Container>> &containers,
                     int num_elements,
                     int num_threads,
                     int num_operations)
 {
     // добавляем num_elements элементов в контейнеры,
     // подсчитываем сумму элементов
+    using T = typename Container::value_type;
+
     T sum1 = T();
     for (int i = 0; i < num_elements; ++i)
     {
         T val = static_cast<T>(i);
         sum1 += val;
-        ((containers[i % 2].operator ->())->*put)(val);
+        Ops::put(*containers[i % 2], std::move(val));
     }
 
     std::vector< std::future<void> > futs;
@@ -269,10 +541,13 @@ bool container_test(std::vector<std::unique_ptr<Container<T>>> &containers,
             for (int j = 0; j < num_operations; ++j)
             {
                 T val;
-                if (((containers[rand() & 1].operator ->())->*get)(val))
+                if (Ops::get(*containers[rand() & 1], val))
                 {
                     extra_work();
-                    ((containers[rand() & 1].operator ->())->*put)(val);
+                    // bounded queue отказывает в put, пока ячейку еще
+                    // читает вытесненный dequeue, - повторяем
+                    while (!Ops::put(*containers[rand() & 1], std::move(val)))
+                        std::this_thread::yield();
                 }
             }
         }));
@@ -293,7 +568,7 @@ bool container_test(std::vector<std::unique_ptr<Container<T>>> &containers,
     for (int i = 0; i < 2; ++i)
     {
         T val;
-        while (((containers[i].operator ->())->*get)(val))
+        while (Ops::get(*containers[i], val))
         {
             node_count++;
             sum2 += val;
@@ -310,33 +585,15 @@ bool container_test(std::vector<std::unique_ptr<Container<T>>> &containers,
     return correct;
 }
 
-// создание lock-free контейнеров с использованием
-// меченых указателей,
-// присутствует второй шаблонный параметр - размер контейнера
-template <template <class> class ContainerBase,
-          template <class, size_t> class ContainerDerived, typename T, size_t N>
-std::vector<std::unique_ptr<ContainerBase<T>>> create_tagged_containers()
-{
-    std::unique_ptr<ContainerDerived<T, N>> c1(new ContainerDerived<T, N>);
-    std::unique_ptr<ContainerDerived<T, N>> c2(new ContainerDerived<T, N>);
-    std::vector<std::unique_ptr<ContainerBase<T>>> containers;
-    containers.emplace_back(std::move(c1));
-    containers.emplace_back(std::move(c2));
-    return containers;
-}
-
-// создание контейнеров,
-// отсутствует второй шаблонный параметр у
-// производного класса (размер контейнера)
-template <template <class> class ContainerBase,
-          template <class> class ContainerDerived, typename T>
-std::vector<std::unique_ptr<ContainerBase<T>>> create_containers()
+// создание двух контейнеров типа Derived,
+// Base - тип, через который к ним обращается тест
+// (сам контейнер или виртуальный интерфейс)
+template <typename Base, typename Derived = Base>
+std::vector<std::unique_ptr<Base>> create_containers()
 {
-    std::unique_ptr<ContainerDerived<T>> c1(new ContainerDerived<T>);
-    std::unique_ptr<ContainerDerived<T>> c2(new ContainerDerived<T>);
-    std::vector<std::unique_ptr<ContainerBase<T>>> containers;
-    containers.emplace_back(std::move(c1));
-    containers.emplace_back(std::move(c2));
+    std::vector<std::unique_ptr<Base>> containers;
+    containers.emplace_back(new Derived);
+    containers.emplace_back(new Derived);
     return containers;
 }
 
@@ -346,28 +603,178 @@ void run_stack_tests()
     std::cout << "==============================="  << std::endl;
     std::cout << "testing lock-based stack:      "  << std::endl;
 
-    auto lock_based_stacks = create_containers<stack, lock_based_stack, T>();
-    container_test(lock_based_stacks, &stack<T>::push,
-                   &stack<T>::pop, num_elements,
-                   num_threads, num_operations);
+    auto lock_based_stacks = create_containers<lock_based_stack<T>>();
+    container_test<stack_ops>(lock_based_stacks, num_elements,
+                              num_threads, num_operations);
 
     std::cout << "==============================="  << std::endl;
     std::cout << "testing tagged lock-free stack:"  << std::endl;
 
-    auto tagged_lock_free_stacks = create_tagged_containers<stack,
-            tagged_lock_free_stack, T, num_elements>();
-    container_test(tagged_lock_free_stacks, &stack<T>::push,
-                   &stack<T>::pop, num_elements,
-                   num_threads, num_operations);
+    auto tagged_lock_free_stacks = create_containers<
+            tagged_lock_free_stack<T, num_elements>>();
+    container_test<stack_ops>(tagged_lock_free_stacks, num_elements,
+                              num_threads, num_operations);
 
     std::cout << "==============================="  << std::endl;
     std::cout << "testing hazard lock-free stack:"  << std::endl;
 
-    auto hazard_lock_free_stacks = create_containers<stack,
-            hazard_lock_free_stack, T>();
-    container_test(hazard_lock_free_stacks, &stack<T>::push,
-                   &stack<T>::pop, num_elements,
-                   num_threads, num_operations);
+    auto hazard_lock_free_stacks = create_containers<
+            hazard_lock_free_stack<T>>();
+    container_test<stack_ops>(hazard_lock_free_stacks, num_elements,
+                              num_threads, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "testing flat combining stack:  "  << std::endl;
+
+    auto flat_combining_stacks = create_containers<flat_combining_stack<T>>();
+    container_test<stack_ops>(flat_combining_stacks, num_elements,
+                              num_threads, num_operations);
+
+    // тот же стек через виртуальный интерфейс stack<T>
+    std::cout << "==============================="  << std::endl;
+    std::cout << "hazard stack via stack<T>:     "  << std::endl;
+
+    auto virtual_stacks = create_containers<stack<T>,
+            stack_adapter<hazard_lock_free_stack<T>>>();
+    container_test<stack_ops>(virtual_stacks, num_elements,
+                              num_threads, num_operations);
+
+    // стеки при большем числе потоков
+    std::cout << "==============================="  << std::endl;
+    std::cout << "lock-based stack, " << num_threads * 2 << " threads:"
+              << std::endl;
+    container_test<stack_ops>(lock_based_stacks, num_elements,
+                              num_threads * 2, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "hazard stack, " << num_threads * 2 << " threads:"
+              << std::endl;
+    container_test<stack_ops>(hazard_lock_free_stacks, num_elements,
+                              num_threads * 2, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "flat combining stack, " << num_threads * 2 << " threads:"
+              << std::endl;
+    container_test<stack_ops>(flat_combining_stacks, num_elements,
+                              num_threads * 2, num_operations);
+}
+
+template <typename T>
+using elimination_hazard_stack =
+        hazard_lock_free_stack<T, hazard_reclamation, elimination_array<T>>;
+
+template <typename T, size_t N>
+using elimination_tagged_stack =
+        tagged_lock_free_stack<T, N, elimination_array<T>>;
+
+// стеки с elimination и без при росте числа потоков:
+// чем больше потоков, тем больше неудачных CAS на вершине стека
+template <typename T>
+void run_elimination_tests()
+{
+    for (int threads = num_threads; threads <= 4 * num_threads; threads *= 2)
+    {
+        std::cout << "==============================="  << std::endl;
+        std::cout << threads << " threads, hazard stack:" << std::endl;
+
+        auto hazard_stacks = create_containers<hazard_lock_free_stack<T>>();
+        container_test<stack_ops>(hazard_stacks, num_elements,
+                                  threads, num_operations);
+
+        std::cout << threads << " threads, elimination hazard stack:"
+                  << std::endl;
+
+        auto elimination_stacks = create_containers<
+                elimination_hazard_stack<T>>();
+        container_test<stack_ops>(elimination_stacks, num_elements,
+                                  threads, num_operations);
+
+        std::cout << threads << " threads, tagged stack:" << std::endl;
+
+        auto tagged_stacks = create_containers<
+                tagged_lock_free_stack<T, num_elements>>();
+        container_test<stack_ops>(tagged_stacks, num_elements,
+                                  threads, num_operations);
+
+        std::cout << threads << " threads, elimination tagged stack:"
+                  << std::endl;
+
+        auto elimination_tagged_stacks = create_containers<
+                elimination_tagged_stack<T, num_elements>>();
+        container_test<stack_ops>(elimination_tagged_stacks, num_elements,
+                                  threads, num_operations);
+    }
+}
+
+// контейнер при росте числа потоков (для сравнения политик ожидания)
+template <typename Ops, typename Container>
+void thread_sweep(const char* name)
+{
+    for (int threads = num_threads; threads <= 4 * num_threads; threads *= 2)
+    {
+        std::cout << name << ", " << threads << " threads: ";
+        auto containers = create_containers<Container>();
+        container_test<Ops>(containers, num_elements,
+                            threads, num_operations);
+    }
+}
+
+template <typename T>
+void run_backoff_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "backoff policies:              "  << std::endl;
+
+    using exp_backoff = exponential_backoff<>;
+    using prop_backoff = proportional_backoff<>;
+
+    thread_sweep<stack_ops, tagged_lock_free_stack<T, num_elements>>(
+                "tagged stack, no backoff");
+    thread_sweep<stack_ops, tagged_lock_free_stack<T, num_elements,
+            no_elimination<T>, exp_backoff>>("tagged stack, exponential");
+    thread_sweep<stack_ops, tagged_lock_free_stack<T, num_elements,
+            no_elimination<T>, prop_backoff>>("tagged stack, proportional");
+
+    thread_sweep<stack_ops, hazard_lock_free_stack<T>>(
+                "hazard stack, no backoff");
+    thread_sweep<stack_ops, hazard_lock_free_stack<T, hazard_reclamation,
+            no_elimination<T>, exp_backoff>>("hazard stack, exponential");
+    thread_sweep<stack_ops, hazard_lock_free_stack<T, hazard_reclamation,
+            no_elimination<T>, prop_backoff>>("hazard stack, proportional");
+
+    thread_sweep<queue_ops, tagged_lock_free_queue<T, num_elements*2>>(
+                "tagged queue, no backoff");
+    thread_sweep<queue_ops, tagged_lock_free_queue<T, num_elements*2,
+            exp_backoff>>("tagged queue, exponential");
+    thread_sweep<queue_ops, tagged_lock_free_queue<T, num_elements*2,
+            prop_backoff>>("tagged queue, proportional");
+
+    thread_sweep<queue_ops, hazard_lock_free_queue<T>>(
+                "hazard queue, no backoff");
+    thread_sweep<queue_ops, hazard_lock_free_queue<T, hazard_reclamation,
+            exp_backoff>>("hazard queue, exponential");
+    thread_sweep<queue_ops, hazard_lock_free_queue<T, hazard_reclamation,
+            prop_backoff>>("hazard queue, proportional");
+
+    thread_sweep<queue_ops, bounded_lock_free_queue<T, num_elements*2>>(
+                "bounded queue, no backoff");
+    thread_sweep<queue_ops, bounded_lock_free_queue<T, num_elements*2,
+            exp_backoff>>("bounded queue, exponential");
+
+    thread_sweep<queue_ops, segmented_lock_free_queue<T>>(
+                "segmented queue, no backoff");
+    thread_sweep<queue_ops, segmented_lock_free_queue<T, 128,
+            hazard_reclamation, exp_backoff>>("segmented queue, exponential");
+
+    lfht_test<T, lock_free_hash_table<key, T, hash_compare<key>,
+            power_of_two_buckets, hazard_reclamation, exp_backoff>>(
+                "lock-free, exponential backoff");
+    lfht_test<T, split_ordered_hash_table<key, T, hash_compare<key>,
+            hazard_reclamation, exp_backoff>>(
+                "split-ordered, exponential backoff");
+    lfht_test<T, open_addressing_hash_table<key, T, hash_compare<key>,
+            hazard_reclamation, exp_backoff>>(
+                "open addressing, exponential backoff");
 }
 
 template <typename T>
@@ -376,57 +783,1534 @@ void run_queue_tests()
     std::cout << "==============================="  << std::endl;
     std::cout << "testing lock-based queue:      "  << std::endl;
 
-    auto lock_based_queues = create_containers<queue, lock_based_queue, T>();
-    container_test(lock_based_queues, &queue<T>::enqueue,
-                   &queue<T>::dequeue, num_elements,
-                   num_threads, num_operations);
+    auto lock_based_queues = create_containers<lock_based_queue<T>>();
+    container_test<queue_ops>(lock_based_queues, num_elements,
+                              num_threads, num_operations);
 
     std::cout << "==============================="  << std::endl;
     std::cout << "testing tagged lock-free queue:"  << std::endl;
 
-    auto tagged_lock_free_queues = create_tagged_containers<queue,
-            tagged_lock_free_queue, T, num_elements*2>();
-    container_test(tagged_lock_free_queues, &queue<T>::enqueue,
-                   &queue<T>::dequeue, num_elements,
-                   num_threads, num_operations);
+    auto tagged_lock_free_queues = create_containers<
+            tagged_lock_free_queue<T, num_elements*2>>();
+    container_test<queue_ops>(tagged_lock_free_queues, num_elements,
+                              num_threads, num_operations);
 
     std::cout << "==============================="  << std::endl;
     std::cout << "testing hazard lock-free queue:"  << std::endl;
 
-    auto hazard_lock_free_queues = create_containers<queue,
-            hazard_lock_free_queue, T>();
-    container_test(hazard_lock_free_queues, &queue<T>::enqueue,
-                   &queue<T>::dequeue, num_elements,
-                   num_threads, num_operations);
+    auto hazard_lock_free_queues = create_containers<
+            hazard_lock_free_queue<T>>();
+    container_test<queue_ops>(hazard_lock_free_queues, num_elements,
+                              num_threads, num_operations);
+
+    // та же очередь через виртуальный интерфейс queue<T>
+    std::cout << "==============================="  << std::endl;
+    std::cout << "hazard queue via queue<T>:     "  << std::endl;
+
+    auto virtual_queues = create_containers<queue<T>,
+            queue_adapter<hazard_lock_free_queue<T>>>();
+    container_test<queue_ops>(virtual_queues, num_elements,
+                              num_threads, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "testing bounded lock-free queue:" << std::endl;
+
+    auto bounded_lock_free_queues = create_containers<
+            bounded_lock_free_queue<T, num_elements*2>>();
+    container_test<queue_ops>(bounded_lock_free_queues, num_elements,
+                              num_threads, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "testing segmented lock-free queue:" << std::endl;
+
+    auto segmented_lock_free_queues = create_containers<
+            segmented_lock_free_queue<T>>();
+    container_test<queue_ops>(segmented_lock_free_queues, num_elements,
+                              num_threads, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "testing flat combining queue:  "  << std::endl;
+
+    auto flat_combining_queues = create_containers<flat_combining_queue<T>>();
+    container_test<queue_ops>(flat_combining_queues, num_elements,
+                              num_threads, num_operations);
+
+    // очереди при большем числе потоков
+    std::cout << "==============================="  << std::endl;
+    std::cout << "tagged queue, " << num_threads * 2 << " threads:"
+              << std::endl;
+    container_test<queue_ops>(tagged_lock_free_queues, num_elements,
+                              num_threads * 2, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "bounded queue, " << num_threads * 2 << " threads:"
+              << std::endl;
+    container_test<queue_ops>(bounded_lock_free_queues, num_elements,
+                              num_threads * 2, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "segmented queue, " << num_threads * 2 << " threads:"
+              << std::endl;
+    container_test<queue_ops>(segmented_lock_free_queues, num_elements,
+                              num_threads * 2, num_operations);
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "flat combining queue, " << num_threads * 2 << " threads:"
+              << std::endl;
+    container_test<queue_ops>(flat_combining_queues, num_elements,
+                              num_threads * 2, num_operations);
 }
 
-struct test_struct
+// producers производителей и один потребитель: каждый производитель
+// кладет num_operations элементов, потребитель забирает все,
+// проверяются сумма и количество полученных элементов
+template <typename Queue, typename T>
+bool producer_consumer_test(const char* name, int producers)
 {
-public:
-    test_struct(): sum(0) { }
-    test_struct(int _sum): sum(_sum) { }
+    std::cout << "==============================="  << std::endl;
+    std::cout << name << ", " << producers << "P1C:" << std::endl;
 
-    test_struct& operator+=(const test_struct& rhs)
+    Queue q;
+    std::vector< std::future<void> > futs;
+    std::atomic<int> threads(producers + 1);
+
+    T sum1 = T();
+    for (int i = 0; i < producers; ++i)
+        for (int j = 0; j < num_operations; ++j)
+            sum1 += static_cast<T>(j);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < producers; ++i)
+        futs.push_back(std::async(std::launch::async, [&]()
+        {
+            --threads;
+            while (threads.load())
+                std::this_thread::yield();
+
+            for (int j = 0; j < num_operations; ++j)
+            {
+                T val = static_cast<T>(j);
+                // очередь заполнена, ждем потребителя
+                while (!q.enqueue(val))
+                    std::this_thread::yield();
+            }
+        }));
+
+    T sum2 = T();
+    int count = 0;
+    --threads;
+    while (threads.load())
+        std::this_thread::yield();
+
+    while (count < producers * num_operations)
     {
-        this->sum += rhs.sum;
-        return *this;
+        T val;
+        if (q.dequeue(val))
+        {
+            sum2 += val;
+            ++count;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
     }
 
-    bool operator==(const test_struct& rhs)
+    for (auto& fut : futs)
+        fut.get();
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> dur = end_time - start_time;
+
+    T val;
+    bool correct = (sum1 == sum2) && !q.dequeue(val);
+    if (correct) std::cout << "correct, ";
+    else std::cout << "error, ";
+
+    std::cout << "work time: " << (dur.count() * 1000) << "ms" << std::endl;
+
+    return correct;
+}
+
+// каналы с одним потребителем: очереди общего назначения
+// против специализированных SPSC и MPSC
+template <typename T>
+void run_channel_tests()
+{
+    producer_consumer_test<hazard_lock_free_queue<T>, T>(
+                "hazard queue", 1);
+    producer_consumer_test<bounded_lock_free_queue<T, 256>, T>(
+                "bounded queue", 1);
+    producer_consumer_test<spsc_lock_free_queue<T, 256>, T>(
+                "spsc queue", 1);
+    producer_consumer_test<mpsc_lock_free_queue<T>, T>(
+                "mpsc queue", 1);
+
+    producer_consumer_test<hazard_lock_free_queue<T>, T>(
+                "hazard queue", num_threads);
+    producer_consumer_test<bounded_lock_free_queue<T, 256>, T>(
+                "bounded queue", num_threads);
+    producer_consumer_test<mpsc_lock_free_queue<T>, T>(
+                "mpsc queue", num_threads);
+}
+
+// пакетные операции: каждый поток num_operations раз кладет пакет
+// из batch элементов и забирает до batch элементов, проверяется,
+// что число добавленных элементов равно числу извлеченных
+template <typename Container, typename Put, typename Get>
+void batch_test(const char* name, size_t batch, Put put, Get get)
+{
+    Container c;
+    std::vector< std::future<void> > futs;
+    std::atomic<long> added(0), removed(0);
+    int ops = static_cast<int>(num_operations / batch);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_threads; ++i)
+        futs.push_back(std::async(std::launch::async, [&]()
+        {
+            std::vector<int> in(batch, 1);
+            std::vector<int> out;
+            for (int j = 0; j < ops; ++j)
+            {
+                added += put(c, in.data(), in.data() + batch);
+                out.clear();
+                removed += get(c, out, batch);
+            }
+        }));
+
+    for (auto& fut : futs)
+        fut.get();
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> dur = end_time - start_time;
+
+    std::vector<int> out;
+    removed += get(c, out, static_cast<size_t>(added.load()));
+
+    std::cout << name << ", batch " << batch << ": "
+              << (added == removed ? "correct, " : "error, ")
+              << "work time: " << (dur.count() * 1000) << "ms" << std::endl;
+}
+
+template <typename Stack>
+void stack_batch_sweep(const char* name)
+{
+    for (size_t batch : {1, 4, 16, 64})
     {
-        return this->sum == rhs.sum;
+        if (batch == 1)
+            batch_test<Stack>(name, batch,
+                [](Stack& s, const int* first, const int*)
+                { return size_t(s.push(*first)); },
+                [](Stack& s, std::vector<int>&, size_t)
+                { int v; return size_t(s.pop(v)); });
+        else
+            batch_test<Stack>(name, batch,
+                [](Stack& s, const int* first, const int* last)
+                { return s.push_bulk(first, last); },
+                [](Stack& s, std::vector<int>& out, size_t)
+                { return s.pop_all(out); });
     }
+}
 
-    int  sum;
-    char data[1000];
-};
+template <typename Queue>
+void queue_batch_sweep(const char* name)
+{
+    for (size_t batch : {1, 4, 16, 64})
+    {
+        if (batch == 1)
+            batch_test<Queue>(name, batch,
+                [](Queue& q, const int* first, const int*)
+                { return size_t(q.enqueue(*first)); },
+                [](Queue& q, std::vector<int>&, size_t)
+                { int v; return size_t(q.dequeue(v)); });
+        else
+            batch_test<Queue>(name, batch,
+                [](Queue& q, const int* first, const int* last)
+                { return q.enqueue_bulk(first, last); },
+                [](Queue& q, std::vector<int>& out, size_t max)
+                {
+                    out.resize(max);
+                    return q.dequeue_bulk(out.data(), max);
+                });
+    }
+}
+
+// сравнение поэлементных (batch 1) и пакетных операций
+void run_batch_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "batch operations:              "  << std::endl;
+
+    stack_batch_sweep<lock_based_stack<int>>("lock-based stack");
+    stack_batch_sweep<tagged_lock_free_stack<int, 1024>>("tagged stack");
+    stack_batch_sweep<hazard_lock_free_stack<int>>("hazard stack");
+    stack_batch_sweep<flat_combining_stack<int>>("flat combining stack");
+    queue_batch_sweep<lock_based_queue<int>>("lock-based queue");
+    queue_batch_sweep<tagged_lock_free_queue<int, 1024>>("tagged queue");
+    queue_batch_sweep<hazard_lock_free_queue<int>>("hazard queue");
+    queue_batch_sweep<flat_combining_queue<int>>("flat combining queue");
+}
 
 template <typename T>
-void run_hash_tests()
+using epoch_lock_free_stack = hazard_lock_free_stack<T, epoch_reclamation>;
+
+template <typename T>
+using epoch_lock_free_queue = hazard_lock_free_queue<T, epoch_reclamation>;
+
+void print_smr_stats()
 {
-    lfht_test<T>();
-    locked_test<T>();
-    tbb_test<T>();
+    std::cout << "peak unreclaimed: "
+              << global_smr_stats.peak_unreclaimed_bytes.load() / 1024
+              << "KB" << std::endl;
+}
+
+// сравнение hazard pointers и эпох: время работы
+// и пиковый объем отложенной, но еще не освобожденной памяти
+template <typename T>
+void run_reclamation_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "stack, hazard pointers:        "  << std::endl;
+
+    smr_stats_reset();
+    auto hazard_stacks = create_containers<hazard_lock_free_stack<T>>();
+    container_test<stack_ops>(hazard_stacks, num_elements,
+                              num_threads, num_operations);
+    print_smr_stats();
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "stack, epochs:                 "  << std::endl;
+
+    smr_stats_reset();
+    auto epoch_stacks = create_containers<epoch_lock_free_stack<T>>();
+    container_test<stack_ops>(epoch_stacks, num_elements,
+                              num_threads, num_operations);
+    print_smr_stats();
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "queue, hazard pointers:        "  << std::endl;
+
+    smr_stats_reset();
+    auto hazard_queues = create_containers<hazard_lock_free_queue<T>>();
+    container_test<queue_ops>(hazard_queues, num_elements,
+                              num_threads, num_operations);
+    print_smr_stats();
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "queue, epochs:                 "  << std::endl;
+
+    smr_stats_reset();
+    auto epoch_queues = create_containers<epoch_lock_free_queue<T>>();
+    container_test<queue_ops>(epoch_queues, num_elements,
+                              num_threads, num_operations);
+    print_smr_stats();
+
+    smr_stats_reset();
+    lfht_test<T, lock_free_hash_table<key, T>>("hash table, hazard pointers");
+    print_smr_stats();
+
+    smr_stats_reset();
+    lfht_test<T, lock_free_hash_table<key, T, hash_compare<key>,
+            power_of_two_buckets, epoch_reclamation>>("hash table, epochs");
+    print_smr_stats();
+}
+
+// короткоживущие потоки: отложенные элементы завершившихся потоков
+// должны освобождаться, а не накапливаться с каждым поколением потоков
+template <typename Stack>
+void thread_churn_test(const char* name, int generations)
+{
+    using T = typename Stack::value_type;
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << name << std::endl;
+
+    smr_stats_reset();
+    Stack s;
+    for (int i = 0; i < num_elements; ++i)
+        s.push(static_cast<T>(i));
+
+    for (int g = 0; g < generations; ++g)
+    {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < num_threads; ++i)
+            workers.emplace_back([&s]()
+            {
+                // меньше порога просмотра, поток завершается
+                // с непустым списком отложенных элементов
+                for (int j = 0; j < 32; ++j)
+                {
+                    T val;
+                    if (s.pop(val))
+                        s.push(val);
+                }
+            });
+
+        for (auto& w : workers)
+            w.join();
+
+        if ((g + 1) % (generations / 4) == 0)
+        {
+            std::cout << "generation " << g + 1 << ", unreclaimed: "
+                      << global_smr_stats.unreclaimed_bytes.load() / 1024
+                      << "KB" << std::endl;
+        }
+    }
+}
+
+// число выделений памяти на пару операций put/get
+// в одном потоке, после прогрева контейнера
+template <typename Ops, typename Container>
+void allocation_test(const char* name)
+{
+    Container c;
+    typename Container::value_type val = 0;
+    for (int i = 0; i < num_operations; ++i)
+    {
+        Ops::put(c, val);
+        Ops::get(c, val);
+    }
+
+    size_t before = thread_allocations;
+    for (int i = 0; i < num_operations; ++i)
+    {
+        Ops::put(c, val);
+        Ops::get(c, val);
+    }
+
+    std::cout << name << ": "
+              << double(thread_allocations - before) / num_operations
+              << " allocations per put/get" << std::endl;
+}
+
+template <typename Table>
+void hash_allocation_test(const char* name)
+{
+    Table ht;
+    for (int i = 0; i < num_elements; ++i)
+        ht.hash_insert(key(i), 0);
+
+    for (int i = 0; i < num_operations; ++i)
+    {
+        ht.hash_delete(key(i % num_elements));
+        ht.hash_insert(key(i % num_elements), 0);
+    }
+
+    size_t before = thread_allocations;
+    for (int i = 0; i < num_operations; ++i)
+    {
+        ht.hash_delete(key(i % num_elements));
+        ht.hash_insert(key(i % num_elements), 0);
+    }
+
+    std::cout << name << ": "
+              << double(thread_allocations - before) / num_operations
+              << " allocations per delete/insert" << std::endl;
+}
+
+// контейнер с пулом узлов на 16 элементов принимает больше элементов,
+// чем помещается в первый блок пула, и отдает их все
+template <typename Ops, typename Container>
+void growth_test(const char* name, int count)
+{
+    Container c;
+    long sum1 = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (!Ops::put(c, i))
+            break;
+        sum1 += i;
+    }
+
+    long sum2 = 0;
+    int n = 0;
+    int val;
+    while (Ops::get(c, val))
+    {
+        sum2 += val;
+        ++n;
+    }
+
+    std::cout << name << ", " << count << " elements: "
+              << ((n == count && sum1 == sum2) ? "correct" : "error")
+              << std::endl;
+}
+
+void run_allocation_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "allocations per operation:     "  << std::endl;
+
+    allocation_test<stack_ops, tagged_lock_free_stack<int>>("tagged stack");
+    allocation_test<queue_ops, tagged_lock_free_queue<int>>("tagged queue");
+    allocation_test<stack_ops, hazard_lock_free_stack<int>>("hazard stack");
+    allocation_test<stack_ops, epoch_lock_free_stack<int>>("epoch stack");
+    allocation_test<queue_ops, hazard_lock_free_queue<int>>("hazard queue");
+    allocation_test<queue_ops, epoch_lock_free_queue<int>>("epoch queue");
+    allocation_test<queue_ops, segmented_lock_free_queue<int>>(
+            "segmented queue");
+    growth_test<stack_ops, tagged_lock_free_stack<int, 16>>(
+            "tagged stack, pool growth", 100000);
+    growth_test<queue_ops, tagged_lock_free_queue<int, 16>>(
+            "tagged queue, pool growth", 100000);
+    hash_allocation_test<lock_free_hash_table<key, int>>("hazard hash table");
+    hash_allocation_test<lock_free_hash_table<key, int, hash_compare<key>,
+            power_of_two_buckets, epoch_reclamation>>("epoch hash table");
+}
+
+template <typename T>
+using slab_hazard_stack = hazard_lock_free_stack<T, hazard_reclamation,
+        no_elimination<T>, no_backoff, slab_allocation>;
+
+template <typename T>
+using slab_hazard_queue = hazard_lock_free_queue<T, hazard_reclamation,
+        no_backoff, slab_allocation>;
+
+template <typename T>
+using slab_hash_table = lock_free_hash_table<key, T, hash_compare<key>,
+        power_of_two_buckets, hazard_reclamation, no_backoff, slab_allocation>;
+
+// нагрузка с выравниванием 64: конструкторы отмечают объекты,
+// созданные по невыровненному адресу (в узле контейнера)
+struct alignas(64) aligned_payload
+{
+    static std::atomic<size_t> misaligned;
+
+    aligned_payload(int v = 0): value(v)
+    {
+        check();
+    }
+
+    aligned_payload(const aligned_payload& other): value(other.value)
+    {
+        check();
+    }
+
+    aligned_payload& operator=(const aligned_payload&) = default;
+
+    void check()
+    {
+        if (reinterpret_cast<uintptr_t>(this) % alignof(aligned_payload))
+            misaligned.fetch_add(1);
+    }
+
+    int value;
+};
+
+std::atomic<size_t> aligned_payload::misaligned(0);
+
+// блоки пула выровнены по запрошенному выравниванию
+// при любом размере, в том числе в узлах контейнеров
+void slab_alignment_test()
+{
+    bool correct = true;
+    std::vector<void*> blocks;
+    for (size_t align : {8, 16, 32, 64, 128, 256, 4096})
+    {
+        for (size_t size : {1, 24, 40, 100, 200, 1000, 3000})
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                void* p = slab_allocate(size, align);
+                correct &= reinterpret_cast<uintptr_t>(p) % align == 0;
+                blocks.push_back(p);
+            }
+            for (void* p : blocks)
+                slab_deallocate(p, size, align);
+            blocks.clear();
+        }
+    }
+
+    aligned_payload::misaligned.store(0);
+    slab_hazard_stack<aligned_payload> s;
+    slab_hazard_queue<aligned_payload> q;
+    for (int i = 0; i < 1000; ++i)
+    {
+        s.push(aligned_payload(i));
+        q.enqueue(aligned_payload(i));
+    }
+    aligned_payload v;
+    while (s.pop(v)) { }
+    while (q.dequeue(v)) { }
+    correct &= aligned_payload::misaligned.load() == 0;
+
+    std::cout << "slab alignment: " << (correct ? "correct" : "error")
+              << std::endl;
+}
+
+// узлы из глобального operator new и из пула slab_allocator:
+// выделения памяти на операцию и время работы
+template <typename T>
+void run_slab_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "node allocation, new vs slab:  "  << std::endl;
+
+    allocation_test<stack_ops, hazard_lock_free_stack<int>>(
+            "hazard stack, new");
+    allocation_test<stack_ops, slab_hazard_stack<int>>(
+            "hazard stack, slab");
+    allocation_test<queue_ops, hazard_lock_free_queue<int>>(
+            "hazard queue, new");
+    allocation_test<queue_ops, slab_hazard_queue<int>>(
+            "hazard queue, slab");
+    hash_allocation_test<lock_free_hash_table<key, int>>(
+            "hash table, new");
+    hash_allocation_test<slab_hash_table<int>>(
+            "hash table, slab");
+    slab_alignment_test();
+
+    thread_sweep<stack_ops, hazard_lock_free_stack<T>>("hazard stack, new");
+    thread_sweep<stack_ops, slab_hazard_stack<T>>("hazard stack, slab");
+    thread_sweep<queue_ops, hazard_lock_free_queue<T>>("hazard queue, new");
+    thread_sweep<queue_ops, slab_hazard_queue<T>>("hazard queue, slab");
+    lfht_test<T, lock_free_hash_table<key, T>>("hash table, new");
+    lfht_test<T, slab_hash_table<T>>("hash table, slab");
+}
+
+// нагрузка размером с test_struct,
+// считает копирования и перемещения в текущем потоке
+struct counted_payload
+{
+    static thread_local size_t copies;
+    static thread_local size_t moves;
+
+    counted_payload(): value(0) { }
+    counted_payload(int v): value(v) { }
+
+    counted_payload(const counted_payload& other): value(other.value)
+    {
+        ++copies;
+    }
+
+    counted_payload(counted_payload&& other) noexcept: value(other.value)
+    {
+        ++moves;
+    }
+
+    counted_payload& operator=(const counted_payload& other)
+    {
+        value = other.value;
+        ++copies;
+        return *this;
+    }
+
+    counted_payload& operator=(counted_payload&& other) noexcept
+    {
+        value = other.value;
+        ++moves;
+        return *this;
+    }
+
+    int  value;
+    char data[1000];
+};
+
+thread_local size_t counted_payload::copies = 0;
+thread_local size_t counted_payload::moves  = 0;
+
+// копирования и перемещения нагрузки на пару операций put/get
+// (put с перемещением)
+template <typename Ops, typename Container>
+void copy_test(const char* name)
+{
+    std::unique_ptr<Container> c(new Container);
+    counted_payload p(1);
+
+    counted_payload::copies = 0;
+    counted_payload::moves = 0;
+    for (int i = 0; i < num_operations; ++i)
+    {
+        Ops::put(*c, std::move(p));
+        Ops::get(*c, p);
+    }
+
+    std::cout << name << ": "
+              << double(counted_payload::copies) / num_operations
+              << " copies, "
+              << double(counted_payload::moves) / num_operations
+              << " moves per put/get" << std::endl;
+}
+
+template <typename Table>
+void hash_copy_test(const char* name)
+{
+    Table ht;
+    counted_payload p(1);
+    int sum = 0;
+
+    counted_payload::copies = 0;
+    counted_payload::moves = 0;
+    for (int i = 0; i < num_operations; ++i)
+    {
+        ht.hash_insert(key(i % num_elements), std::move(p));
+        ht.hash_visit(key(i % num_elements), [&sum](const counted_payload& v)
+        {
+            sum += v.value;
+        });
+        ht.hash_delete(key(i % num_elements));
+    }
+
+    std::cout << name << ": "
+              << double(counted_payload::copies) / num_operations
+              << " copies, "
+              << double(counted_payload::moves) / num_operations
+              << " moves per insert/visit" << std::endl;
+}
+
+void run_copy_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "payload copies per operation:  "  << std::endl;
+
+    using P = counted_payload;
+    copy_test<stack_ops, lock_based_stack<P>>("lock-based stack");
+    copy_test<stack_ops, tagged_lock_free_stack<P, 16>>("tagged stack");
+    copy_test<stack_ops, hazard_lock_free_stack<P>>("hazard stack");
+    copy_test<queue_ops, lock_based_queue<P>>("lock-based queue");
+    copy_test<queue_ops, tagged_lock_free_queue<P, 16>>("tagged queue");
+    copy_test<queue_ops, hazard_lock_free_queue<P>>("hazard queue");
+    copy_test<queue_ops, bounded_lock_free_queue<P, 16>>("bounded queue");
+    copy_test<queue_ops, segmented_lock_free_queue<P>>("segmented queue");
+    copy_test<queue_ops, spsc_lock_free_queue<P, 16>>("spsc queue");
+    copy_test<queue_ops, mpsc_lock_free_queue<P>>("mpsc queue");
+    hash_copy_test<lock_free_hash_table<key, P>>("lock-free hash table");
+    hash_copy_test<split_ordered_hash_table<key, P>>("split-ordered hash table");
+}
+
+// владелец добавляет и извлекает элементы, остальные потоки их
+// перехватывают: каждый элемент должен быть получен ровно один раз
+template <typename R>
+bool deque_test(const char* name, int thieves, int count)
+{
+    chase_lev_deque<int, R> d(2);
+    std::vector<std::atomic<int>> seen(count);
+    for (auto& s : seen)
+        s.store(0);
+    std::atomic<bool> done(false);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < thieves; ++i)
+        workers.emplace_back([&]()
+        {
+            int v;
+            while (!done.load())
+            {
+                if (d.steal(v))
+                    seen[v].fetch_add(1);
+            }
+        });
+
+    int v;
+    for (int i = 0; i < count; ++i)
+    {
+        d.push(i);
+        // примерно треть элементов владелец забирает сам
+        if (i % 3 == 0 && d.pop(v))
+            seen[v].fetch_add(1);
+    }
+    while (d.pop(v))
+        seen[v].fetch_add(1);
+
+    done.store(true);
+    for (auto& w : workers)
+        w.join();
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> dur = end_time - start_time;
+
+    bool correct = true;
+    for (auto& s : seen)
+        correct = correct && s.load() == 1;
+
+    std::cout << name << ", " << thieves << " thieves: "
+              << (correct ? "correct, " : "error, ")
+              << "work time: " << (dur.count() * 1000) << "ms" << std::endl;
+    return correct;
+}
+
+// parallel_for по count элементам, задачи не меньше grain элементов
+template <typename Executor>
+void parallel_for_test(const char* name, size_t threads,
+                       size_t count, size_t grain)
+{
+    std::vector<int> out(count, 0);
+    Executor e(threads);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int round = 0; round < 4; ++round)
+        parallel_for(e, 0, count, grain,
+                     [&out](size_t i) { out[i] += extra_work() % 7 + 1; });
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> dur = end_time - start_time;
+
+    bool correct = true;
+    for (int v : out)
+        correct = correct && v == 4 * (extra_work() % 7 + 1);
+
+    std::cout << name << ", " << threads << " threads, grain " << grain
+              << ": " << (correct ? "correct, " : "error, ")
+              << "work time: " << (dur.count() * 1000) << "ms" << std::endl;
+}
+
+void run_work_stealing_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "work-stealing deque:           "  << std::endl;
+
+    for (int thieves : {1, num_threads})
+    {
+        deque_test<hazard_reclamation>("chase-lev, hazard", thieves, 100000);
+        deque_test<epoch_reclamation>("chase-lev, epoch", thieves, 100000);
+    }
+
+    std::cout << "==============================="  << std::endl;
+    std::cout << "parallel for:                  "  << std::endl;
+
+    for (size_t threads : {1, 2, 4})
+    {
+        for (size_t grain : {16, 1024})
+        {
+            parallel_for_test<work_stealing_executor<>>(
+                    "work stealing", threads, 1 << 18, grain);
+            parallel_for_test<central_queue_executor<>>(
+                    "central queue", threads, 1 << 18, grain);
+        }
+    }
+}
+
+// обход таблицы во время изменений: ключи [0, stable) не меняются
+// и должны встретиться ровно один раз, остальные удаляются
+// и вставляются обратно другими потоками
+template <typename Table>
+void iteration_test(const char* name)
+{
+    const int keys = 8192;
+    const int stable = keys / 2;
+
+    Table ht(1024);
+    for (int i = 0; i < keys; ++i)
+        ht.hash_insert(key(i), i);
+
+    std::atomic<bool> done(false);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < num_threads; ++t)
+        writers.emplace_back([&, t]()
+        {
+            std::mt19937 gen(t + 1);
+            while (!done.load())
+            {
+                int k = stable + static_cast<int>(gen() % (keys - stable));
+                if (ht.hash_delete(key(k)))
+                    ht.hash_insert(key(k), k);
+            }
+        });
+
+    bool correct = true;
+    for (int pass = 0; pass < 20; ++pass)
+    {
+        std::vector<int> seen(keys, 0);
+        auto view = ht.items();
+        for (auto it = view.begin(); it != view.end(); ++it)
+        {
+            int k = it.key().value;
+            correct &= (k >= 0 && k < keys && it.value() == k);
+            if (k >= 0 && k < keys)
+                ++seen[k];
+        }
+
+        for (int k = 0; k < keys; ++k)
+            correct &= (seen[k] <= 1) && (k >= stable || seen[k] == 1);
+
+        // параллельная свертка видит все неизменные ключи
+        long long stable_sum = ht.parallel_reduce(0LL,
+                [](const key& k, const int&) -> long long
+                { return k.value < stable ? k.value : 0; },
+                [](long long a, long long b) { return a + b; },
+                [](long long a, long long b) { return a + b; },
+                num_threads);
+        correct &= stable_sum == static_cast<long long>(stable) * (stable - 1) / 2;
+    }
+
+    done.store(true);
+    for (auto& w : writers)
+        w.join();
+
+    std::atomic<size_t> visited(0);
+    size_t count = ht.parallel_for_each([&visited](const key&, const int&)
+    {
+        visited.fetch_add(1);
+    }, num_threads);
+    correct &= count == size_t(keys) && visited.load() == size_t(keys);
+    correct &= ht.get_sum() == keys * (keys - 1) / 2;
+
+    std::cout << name << ": " << (correct ? "correct" : "error") << std::endl;
+}
+
+// свертка большой таблицы в threads потоков
+template <typename Table>
+void parallel_reduce_test(const char* name, size_t size)
+{
+    Table ht(size);
+    for (size_t i = 0; i < size; ++i)
+        ht.hash_insert(key(static_cast<int>(i)), 1);
+
+    for (size_t threads : {size_t(1), size_t(num_threads)})
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        long long sum = ht.parallel_reduce(0LL,
+                [](const key&, const int& v) -> long long { return v; },
+                [](long long a, long long b) { return a + b; },
+                [](long long a, long long b) { return a + b; },
+                threads);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> dur = end_time - start_time;
+
+        std::cout << name << ", " << size << " keys, " << threads
+                  << " threads: "
+                  << (sum == static_cast<long long>(size) ? "correct, " : "error, ")
+                  << "work time: " << (dur.count() * 1000) << "ms" << std::endl;
+    }
+
+    // потоки планировщика создаются один раз на все обходы
+    work_stealing_executor<> executor(num_threads);
+    auto start_time = std::chrono::high_resolution_clock::now();
+    bool correct = true;
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        long long sum = ht.parallel_reduce(executor, 0LL,
+                [](const key&, const int& v) -> long long { return v; },
+                [](long long a, long long b) { return a + b; },
+                [](long long a, long long b) { return a + b; });
+        correct &= sum == static_cast<long long>(size);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> dur = end_time - start_time;
+    correct &= ht.parallel_for_each(executor,
+            [](const key&, const int&) { }) == size;
+    correct &= ht.stats(executor).elements == size;
+
+    std::cout << name << ", " << size << " keys, executor: "
+              << (correct ? "correct, " : "error, ")
+              << "work time: " << (dur.count() * 1000 / 4) << "ms" << std::endl;
+}
+
+void run_iteration_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "concurrent iteration:          "  << std::endl;
+
+    using hazard_table = lock_free_hash_table<key, int>;
+    using epoch_table = lock_free_hash_table<key, int, hash_compare<key>,
+            power_of_two_buckets, epoch_reclamation>;
+
+    iteration_test<hazard_table>("hazard hash table");
+    iteration_test<epoch_table>("epoch hash table");
+    parallel_reduce_test<hazard_table>("hazard hash table", 1 << 20);
+    parallel_reduce_test<epoch_table>("epoch hash table", 1 << 20);
+}
+
+// insert_or_assign, compare_exchange_value и update в одном потоке
+template <typename Table>
+bool assign_test(const char* name)
+{
+    Table ht;
+    bool correct = true;
+
+    correct &= ht.insert_or_assign(key(1), 10);
+    correct &= !ht.insert_or_assign(key(1), 11);
+
+    int expected = 10;
+    correct &= !ht.compare_exchange_value(key(1), expected, 12);
+    correct &= (expected == 11);
+    correct &= ht.compare_exchange_value(key(1), expected, 12);
+    correct &= !ht.compare_exchange_value(key(2), expected, 13);
+
+    correct &= ht.update(key(1), [](int& v) { v += 5; });
+    correct &= !ht.update(key(2), [](int& v) { v += 5; });
+
+    int val = 0;
+    correct &= ht.hash_search(key(1), val) && (val == 17);
+    correct &= !ht.hash_search(key(2), val);
+
+    std::cout << name << ": " << (correct ? "correct" : "error") << std::endl;
+    return correct;
+}
+
+// потоки увеличивают общие счетчики: update за один проход
+// против delete + insert (как в lfht_test), где обновления
+// теряются, пока ключа нет в таблице
+template <typename Table>
+void counter_test(const char* name, bool use_update)
+{
+    const int counters = 64;
+
+    Table ht;
+    for (int i = 0; i < counters; ++i)
+        ht.hash_insert(key(i), 0);
+
+    std::atomic<int> applied(0);
+    std::vector<std::future<void>> futs;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int t = 0; t < num_threads; ++t)
+        futs.push_back(std::async(std::launch::async, [&, t]()
+        {
+            int done = 0;
+            for (int j = 0; j < num_operations; ++j)
+            {
+                key k((j + t) % counters);
+                if (use_update)
+                    done += ht.update(k, [](int& v) { ++v; });
+                else
+                {
+                    int v;
+                    if (ht.hash_search(k, v) && ht.hash_delete(k))
+                    {
+                        ht.hash_insert(k, v + 1);
+                        ++done;
+                    }
+                }
+            }
+            applied.fetch_add(done);
+        }));
+
+    for (auto& fut : futs)
+        fut.get();
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> dur = end_time - start_time;
+
+    int sum = 0;
+    for (int i = 0; i < counters; ++i)
+    {
+        int v = 0;
+        ht.hash_search(key(i), v);
+        sum += v;
+    }
+
+    // update не теряет ни одного увеличения, у delete + insert
+    // два потока могут прочитать одно значение до удаления
+    std::cout << name << ": ";
+    if (use_update)
+        std::cout << (sum == num_threads * num_operations &&
+                      sum == applied.load() ? "correct, " : "error, ");
+    std::cout << sum << " of " << applied.load()
+              << " increments kept, work time: "
+              << (dur.count() * 1000) << "ms" << std::endl;
+}
+
+void run_assign_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "in-place value updates:        "  << std::endl;
+
+    using hazard_table = lock_free_hash_table<key, int>;
+    using epoch_table = lock_free_hash_table<key, int, hash_compare<key>,
+            power_of_two_buckets, epoch_reclamation>;
+
+    assign_test<hazard_table>("hazard hash table");
+    assign_test<epoch_table>("epoch hash table");
+    counter_test<hazard_table>("hazard, update", true);
+    counter_test<hazard_table>("hazard, delete + insert", false);
+    counter_test<epoch_table>("epoch, update", true);
+    counter_test<epoch_table>("epoch, delete + insert", false);
+}
+
+// поиск случайных ключей поодиночке и группами с prefetch
+// в таблице с size ключами (одна корзина на ключ)
+template <typename Table>
+void batch_lookup_test(const char* name, size_t size)
+{
+    const size_t lookups = 1 << 20;
+    const size_t batch = 32;
+
+    Table ht(size);
+    std::vector<key> keys(size);
+    std::vector<int> values(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        keys[i] = key(static_cast<int>(i));
+        values[i] = static_cast<int>(i);
+    }
+    bool correct = ht.hash_insert_batch(keys.data(), values.data(), size) == size;
+
+    std::mt19937 gen(1);
+    std::vector<key> queries(lookups);
+    for (auto& q : queries)
+        q = key(static_cast<int>(gen() % (2 * size)));
+
+    std::vector<int> results(lookups);
+    std::unique_ptr<bool[]> found(new bool[lookups]);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < lookups; ++i)
+        found[i] = ht.hash_search(queries[i], results[i]);
+    auto middle_time = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < lookups; ++i)
+        correct &= found[i] == (queries[i].value < static_cast<int>(size)) &&
+                   (!found[i] || results[i] == queries[i].value);
+
+    auto batch_time = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < lookups; i += batch)
+        ht.hash_search_batch(&queries[i], batch, &results[i], &found[i]);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    for (size_t i = 0; i < lookups; ++i)
+        correct &= found[i] == (queries[i].value < static_cast<int>(size)) &&
+                   (!found[i] || results[i] == queries[i].value);
+
+    std::chrono::duration<double> single = middle_time - start_time;
+    std::chrono::duration<double> batched = end_time - batch_time;
+    std::cout << name << ", " << size << " keys: "
+              << (correct ? "correct, " : "error, ")
+              << "single: " << (single.count() * 1e9 / lookups) << "ns, "
+              << "batch " << batch << ": "
+              << (batched.count() * 1e9 / lookups) << "ns per lookup"
+              << std::endl;
+}
+
+void run_batch_lookup_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "batched hash lookups:          "  << std::endl;
+
+    using hazard_table = lock_free_hash_table<key, int>;
+    using epoch_table = lock_free_hash_table<key, int, hash_compare<key>,
+            power_of_two_buckets, epoch_reclamation>;
+
+    // 4M ключей (узлы и корзины ~200MB) не помещаются в LLC
+    for (size_t size : {size_t(1) << 16, size_t(1) << 22})
+    {
+        batch_lookup_test<hazard_table>("hazard hash table", size);
+        batch_lookup_test<epoch_table>("epoch hash table", size);
+    }
+}
+
+// упорядоченный словарь в одном потоке: поиск, удаление, диапазоны
+template <typename Map>
+bool ordered_map_test(const char* name)
+{
+    Map m;
+    bool correct = true;
+
+    std::vector<int> keys(num_elements);
+    for (int i = 0; i < num_elements; ++i)
+        keys[i] = i;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+
+    for (int k : keys)
+        correct &= m.insert(k, k);
+    correct &= !m.insert(keys[0], 0);
+
+    for (int i = 0; i < num_elements; i += 2)
+        correct &= m.erase(i);
+    correct &= !m.erase(0);
+
+    for (int i = 0; i < num_elements; ++i)
+    {
+        int val = -1;
+        bool found = m.find(i, val);
+        correct &= (found == (i % 2 == 1)) && (!found || val == i);
+    }
+
+    // нечетные ключи из [10, 50) по возрастанию
+    int expected = 11;
+    size_t count = m.for_each(10, 50, [&](const int& k, const int& v)
+    {
+        correct &= (k == expected) && (v == k);
+        expected += 2;
+    });
+    correct &= (count == 20) && (expected == 51);
+
+    std::cout << name << ": " << (correct ? "correct" : "error") << std::endl;
+    return correct;
+}
+
+// смешанная нагрузка: поиск, удаление со вставкой обратно
+// и просмотр диапазонов, в которых ключи должны возрастать
+template <typename Map>
+void ordered_map_bench(const char* name, int threads, int scan_percent)
+{
+    const int keys = 4096;
+    const int scan_length = 64;
+
+    Map m;
+    for (int i = 0; i < keys; ++i)
+        m.insert(i, i);
+
+    std::atomic<bool> ordered(true);
+    std::vector<std::future<void>> futs;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int t = 0; t < threads; ++t)
+        futs.push_back(std::async(std::launch::async, [&, t]()
+        {
+            std::mt19937 gen(t + 1);
+            for (int j = 0; j < num_operations; ++j)
+            {
+                int key = static_cast<int>(gen() % keys);
+                int op = static_cast<int>(gen() % 100);
+                if (op < scan_percent)
+                {
+                    int prev = -1;
+                    m.for_each(key, key + scan_length,
+                               [&](const int& k, const int& v)
+                    {
+                        if (k <= prev || v != k)
+                            ordered.store(false);
+                        prev = k;
+                    });
+                }
+                else if (op < scan_percent + 10)
+                {
+                    if (m.erase(key))
+                        m.insert(key, key);
+                }
+                else
+                {
+                    int val;
+                    if (m.find(key, val) && val != key)
+                        ordered.store(false);
+                }
+            }
+        }));
+
+    for (auto& fut : futs)
+        fut.get();
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> dur = end_time - start_time;
+
+    // все удаленные ключи вставлены обратно
+    long long sum = 0;
+    size_t count = m.for_each(0, keys, [&sum](const int& k, const int&)
+    {
+        sum += k;
+    });
+    bool correct = ordered.load() && count == size_t(keys) &&
+            sum == static_cast<long long>(keys) * (keys - 1) / 2;
+
+    std::cout << name << ", " << threads << " threads, "
+              << scan_percent << "% scans: "
+              << (correct ? "correct, " : "error, ")
+              << "work time: " << (dur.count() * 1000) << "ms" << std::endl;
+}
+
+void run_ordered_map_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "ordered maps:                  "  << std::endl;
+
+    ordered_map_test<lock_free_skip_list<int, int>>("lock-free skip list");
+    ordered_map_test<lock_based_map<int, int>>("std::map + shared_mutex");
+
+    for (int threads : {1, num_threads})
+    {
+        for (int scans : {0, 20})
+        {
+            ordered_map_bench<lock_free_skip_list<int, int>>(
+                    "lock-free skip list", threads, scans);
+            ordered_map_bench<lock_based_map<int, int>>(
+                    "std::map + shared_mutex", threads, scans);
+        }
+    }
+}
+
+// size() и empty() после одновременных put/get: каждый поток добавляет
+// count элементов и забирает каждый второй. В покое счетчик точный
+template <typename Ops, typename Container>
+bool size_test(const char* name, int threads, int count)
+{
+    std::unique_ptr<Container> c(new Container);
+    bool correct = c->empty() && c->size() == 0;
+
+    std::atomic<size_t> puts(0);
+    std::atomic<size_t> gets(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([&]()
+        {
+            int value = 0;
+            for (int i = 0; i < count; ++i)
+            {
+                if (Ops::put(*c, i))
+                    puts.fetch_add(1);
+                if (i % 2 == 1 && Ops::get(*c, value))
+                    gets.fetch_add(1);
+            }
+        });
+    for (auto& w : workers)
+        w.join();
+
+    size_t expected = puts.load() - gets.load();
+    correct &= c->size() == expected && c->empty() == (expected == 0);
+
+    int value;
+    size_t drained = 0;
+    while (Ops::get(*c, value))
+        ++drained;
+    correct &= drained == expected && c->size() == 0 && c->empty();
+
+    std::cout << name << ": " << (correct ? "correct" : "error") << std::endl;
+    return correct;
+}
+
+// счетчик без полос для сравнения
+struct shared_counter
+{
+    std::atomic<int64_t> value;
+
+    shared_counter(): value(0) { }
+
+    void increment()
+    {
+        value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int64_t sum() const
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+};
+
+// threads потоков увеличивают один счетчик
+template <typename Counter>
+void counter_bench(const char* name, int threads)
+{
+    const int count = 1 << 22;
+    Counter counter;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([&counter]()
+        {
+            for (int i = 0; i < count; ++i)
+                counter.increment();
+        });
+    for (auto& w : workers)
+        w.join();
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> dur = end_time - start_time;
+
+    bool correct = counter.sum() == static_cast<int64_t>(count) * threads;
+    std::cout << name << ", " << threads << " threads: "
+              << (correct ? "correct, " : "error, ")
+              << "work time: " << (dur.count() * 1000) << "ms" << std::endl;
+}
+
+// точное чтение счетчика: каждый поток прибавляет и сразу вычитает 1,
+// поэтому в любой момент значение от 0 до threads. Обычная сумма
+// читает ячейки в разные моменты и может выйти за эти границы
+void exact_counter_test(int threads, int count)
+{
+    striped_counter<> counter;
+    std::atomic<int> running(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([&counter, &running, count]()
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                counter.increment();
+                counter.decrement();
+            }
+            running.fetch_sub(1);
+        });
+
+    bool correct = true;
+    size_t reads = 0;
+    while (running.load() > 0)
+    {
+        int64_t s = counter.exact_sum();
+        correct &= s >= 0 && s <= threads;
+        ++reads;
+    }
+    for (auto& w : workers)
+        w.join();
+    correct &= counter.exact_sum() == 0 && counter.sum() == 0;
+
+    std::cout << "striped counter exact sum: "
+              << (correct ? "correct" : "error")
+              << ", reads: " << reads << std::endl;
+}
+
+// размер хеш-таблицы после одновременных вставок и удалений:
+// поток вставляет свои count ключей и удаляет каждый третий,
+// затем статистика заполнения обходом
+template <typename Table>
+void hash_size_test(const char* name, int threads, int count)
+{
+    Table ht;
+    bool correct = ht.empty() && ht.size() == 0;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([&ht, t, count]()
+        {
+            for (int i = 0; i < count; ++i)
+                ht.hash_insert(key(t * count + i), i);
+            for (int i = 0; i < count; i += 3)
+                ht.hash_delete(key(t * count + i));
+        });
+    for (auto& w : workers)
+        w.join();
+
+    size_t expected = size_t(threads) * (count - (count + 2) / 3);
+    hash_table_stats s = ht.stats();
+    correct &= ht.size() == expected && !ht.empty() && s.elements == expected;
+
+    std::cout << name << ": " << (correct ? "correct" : "error")
+              << ", size: " << ht.size()
+              << ", buckets: " << s.buckets
+              << ", load factor: " << ht.load_factor()
+              << ", longest chain: " << s.longest_chain
+              << ", average chain: " << s.average_chain() << std::endl;
+}
+
+template <typename Map>
+void map_size_test(const char* name, int threads, int count)
+{
+    Map m;
+    bool correct = m.empty() && m.size() == 0;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([&m, t, count]()
+        {
+            for (int i = 0; i < count; ++i)
+                m.insert(t * count + i, i);
+            for (int i = 0; i < count; i += 3)
+                m.erase(t * count + i);
+        });
+    for (auto& w : workers)
+        w.join();
+
+    size_t expected = size_t(threads) * (count - (count + 2) / 3);
+    correct &= m.size() == expected && !m.empty();
+    for (int k = 0; k < threads * count; ++k)
+        m.erase(k);
+    correct &= m.size() == 0 && m.empty();
+
+    std::cout << name << ": " << (correct ? "correct" : "error") << std::endl;
+}
+
+void run_size_tests()
+{
+    std::cout << "==============================="  << std::endl;
+    std::cout << "container sizes:               "  << std::endl;
+
+    const int count = 10000;
+    size_test<stack_ops, lock_based_stack<int>>(
+            "lock-based stack", num_threads, count);
+    size_test<stack_ops, tagged_lock_free_stack<int>>(
+            "tagged stack", num_threads, count);
+    size_test<stack_ops, hazard_lock_free_stack<int>>(
+            "hazard stack", num_threads, count);
+    size_test<stack_ops, hazard_lock_free_stack<int, hazard_reclamation,
+            elimination_array<int>>>(
+            "hazard stack, elimination", num_threads, count);
+    size_test<stack_ops, flat_combining_stack<int>>(
+            "flat combining stack", num_threads, count);
+    size_test<stack_ops, stack_adapter<hazard_lock_free_stack<int>>>(
+            "stack<int> adapter", num_threads, count);
+
+    size_test<queue_ops, lock_based_queue<int>>(
+            "lock-based queue", num_threads, count);
+    size_test<queue_ops, tagged_lock_free_queue<int>>(
+            "tagged queue", num_threads, count);
+    size_test<queue_ops, hazard_lock_free_queue<int>>(
+            "hazard queue", num_threads, count);
+    size_test<queue_ops, bounded_lock_free_queue<int, 1 << 16>>(
+            "bounded queue", num_threads, count);
+    size_test<queue_ops, segmented_lock_free_queue<int>>(
+            "segmented queue", num_threads, count);
+    size_test<queue_ops, flat_combining_queue<int>>(
+            "flat combining queue", num_threads, count);
+    size_test<queue_ops, queue_adapter<hazard_lock_free_queue<int>>>(
+            "queue<int> adapter", num_threads, count);
+    // один производитель и потребитель
+    size_test<queue_ops, spsc_lock_free_queue<int, 1 << 14>>(
+            "spsc queue", 1, count);
+    size_test<queue_ops, mpsc_lock_free_queue<int>>(
+            "mpsc queue", 1, count);
+
+    hash_size_test<lock_free_hash_table<key, int>>(
+            "lock-free hash table", num_threads, count);
+    hash_size_test<split_ordered_hash_table<key, int>>(
+            "split-ordered hash table", num_threads, count);
+    hash_size_test<open_addressing_hash_table<key, int>>(
+            "open addressing hash table", num_threads, count);
+    hash_size_test<lock_based_hash_table<key, int>>(
+            "locked hash table", num_threads, count);
+
+    map_size_test<lock_free_skip_list<int, int>>(
+            "lock-free skip list", num_threads, count);
+    map_size_test<lock_based_map<int, int>>(
+            "std::map + shared_mutex", num_threads, count);
+
+    exact_counter_test(num_threads, count);
+
+    for (int threads : {1, num_threads})
+    {
+        counter_bench<shared_counter>("shared atomic counter", threads);
+        counter_bench<striped_counter<>>("striped counter", threads);
+    }
+}
+
+struct test_struct
+{
+public:
+    test_struct(): sum(0) { }
+    test_struct(int _sum): sum(_sum) { }
+
+    test_struct& operator+=(const test_struct& rhs)
+    {
+        this->sum += rhs.sum;
+        return *this;
+    }
+
+    bool operator==(const test_struct& rhs)
+    {
+        return this->sum == rhs.sum;
+    }
+
+    int  sum;
+    char data[1000];
+};
+
+template <typename T>
+void run_hash_tests()
+{
+    lfht_test<T, lock_free_hash_table<key, T>>("lock-free");
+    lfht_test<T, split_ordered_hash_table<key, T>>("split-ordered");
+    lfht_test<T, open_addressing_hash_table<key, T>>("open addressing");
+    locked_test<T>();
+    tbb_test<T>();
+
+    auto string_key = [](int i) { return "key-" + std::to_string(i); };
+    auto id_key = [](int i) { return id128(static_cast<uint64_t>(i) << 40, i); };
+
+    keys_test<lock_free_hash_table<std::string, int>>(
+                "lock-free, string keys", string_key);
+    keys_test<split_ordered_hash_table<std::string, int>>(
+                "split-ordered, string keys", string_key);
+    keys_test<lock_based_hash_table<std::string, int>>(
+                "lock-based, string keys", string_key);
+    keys_test<lock_free_hash_table<id128, int>>(
+                "lock-free, 128-bit keys", id_key);
+    keys_test<open_addressing_hash_table<id128, int>>(
+                "open addressing, 128-bit keys", id_key);
+
+    tombstone_reuse_test<open_addressing_hash_table<key, versioned_value>>(
+                "open addressing, tombstone reuse");
+    migration_search_test<open_addressing_hash_table<key, int>>(
+                "open addressing, search during migration");
 }
 
 template <typename T>
@@ -434,8 +2318,26 @@ void run_tests()
 {
     std::cout << num_threads << " threads working..." << std::endl;
     run_stack_tests<T>();
+    run_elimination_tests<T>();
     run_queue_tests<T>();
+    run_channel_tests<T>();
+    run_batch_tests();
     run_hash_tests<T>();
+    run_backoff_tests<T>();
+    run_reclamation_tests<T>();
+    thread_churn_test<hazard_lock_free_stack<T>>(
+            "thread churn, hazard pointers: ", 200);
+    thread_churn_test<epoch_lock_free_stack<T>>(
+            "thread churn, epochs:          ", 200);
+    run_allocation_tests();
+    run_slab_tests<T>();
+    run_copy_tests();
+    run_work_stealing_tests();
+    run_ordered_map_tests();
+    run_batch_lookup_tests();
+    run_assign_tests();
+    run_iteration_tests();
+    run_size_tests();
 }
 
 int main()